@@ -0,0 +1,66 @@
+#ifndef ACCEPTOR_H
+#define ACCEPTOR_H
+
+#include <pthread.h>
+#include "poker_client.h"  // for player_id_t
+#include "reactor.h"       // for reactor_t
+#include "table.h"         // for table_pool_t
+
+#define BASE_PORT 2201
+#define NUM_PORTS 6
+
+struct acceptor;
+
+// A listening socket, and the seat a plain JOIN on it takes
+typedef struct {
+    int fd;
+    player_id_t seat;
+    struct acceptor *acceptor;
+} listener_t;
+
+/**
+ * @brief one thread accepting players and reading their JOIN
+ *
+ * every acceptor listens on the first port through its own socket, bound with SO_REUSEPORT,
+ * so the kernel spreads the new connections over them. the first acceptor may also listen on
+ * the seat ports the original clients connect to. a connection stays with its acceptor until
+ * its JOIN sat it down at a table, then goes to the worker of that table
+ */
+typedef struct acceptor {
+    int id;
+    pthread_t thread;
+    reactor_t *reactor;
+    table_pool_t *pool;
+    listener_t listeners[NUM_PORTS];
+    int num_listeners;
+    int stop;
+} acceptor_t;
+
+/**
+ * @brief creates an acceptor and opens its listening sockets
+ *
+ * @param seat_ports also listen on ports BASE_PORT + 1 .. BASE_PORT + NUM_PORTS - 1, where a plain
+ *                   JOIN takes the seat of the port. only one acceptor can have them
+ * @param backend how the acceptor's reactor talks to the kernel
+ * @return 0 on success, -1 if a socket could not be opened
+ */
+int acceptor_init(acceptor_t *acceptor, table_pool_t *pool, int id, int seat_ports, reactor_backend_t backend);
+
+/**
+ * @brief closes the listening sockets of an acceptor and frees its reactor
+ */
+void acceptor_destroy(acceptor_t *acceptor);
+
+/**
+ * @brief runs an acceptor on a thread of its own, until acceptor_stop
+ *
+ * @return 0 on success, -1 if the thread could not be started
+ */
+int acceptor_start(acceptor_t *acceptor);
+
+/**
+ * @brief stops the thread of an acceptor and waits for it
+ */
+void acceptor_stop(acceptor_t *acceptor);
+
+#endif
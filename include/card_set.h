@@ -0,0 +1,87 @@
+#ifndef CARD_SET_H
+#define CARD_SET_H
+
+#include <stdint.h>
+#include "poker_client.h"  // for card_t
+
+/**
+ * a set of cards packed into one 64 bit word
+ *
+ * every suit owns a 16 bit lane (DIAMOND in bits 0-15, CLUB in 16-31, HEART in 32-47 and
+ * SPADE in 48-63) and the lower 13 bits of a lane hold one bit per rank, TWO in bit 0 up to
+ * ACE in bit 12. the top 3 bits of every lane are always 0.
+ *
+ *  card_set_t hand = card_set_of(ACE OF SPADE) | card_set_of(TWO OF SPADE);
+ */
+typedef uint64_t card_set_t;
+
+#define CARD_SET_LANE_BITS 16
+#define CARD_SET_RANK_MASK 0x1fff
+
+// lowest bit of every lane
+#define CARD_SET_LANE_ONES 0x0001000100010001ull
+
+/**
+ * @brief the set holding only the given card
+ */
+static inline card_set_t card_set_of(card_t card) {
+    return 1ull << (SUITE(card) * CARD_SET_LANE_BITS + RANK(card));
+}
+
+/**
+ * @brief builds a set out of an array of cards, NOCARD entries are skipped
+ */
+static inline card_set_t card_set_from_cards(const card_t *cards, int num_cards) {
+    card_set_t set = 0;
+    for (int i = 0; i < num_cards; i++) {
+        if (cards[i] != NOCARD) set |= card_set_of(cards[i]);
+    }
+    return set;
+}
+
+/**
+ * @brief the 13 bit rank mask of one suit
+ */
+static inline int card_set_suit(card_set_t set, int suit) {
+    return (int)(set >> (suit * CARD_SET_LANE_BITS)) & CARD_SET_RANK_MASK;
+}
+
+/**
+ * @brief the 13 bit mask of every rank that appears in the set, in any suit
+ */
+static inline int card_set_ranks(card_set_t set) {
+    return card_set_suit(set, DIAMOND) | card_set_suit(set, CLUB) |
+           card_set_suit(set, HEART) | card_set_suit(set, SPADE);
+}
+
+/**
+ * @brief number of cards in the set
+ */
+static inline int card_set_size(card_set_t set) {
+    return __builtin_popcountll(set);
+}
+
+/**
+ * @brief counts the cards of every suit in parallel
+ *
+ * @return the count of a suit sits in the low byte of that suit's lane
+ */
+static inline uint64_t card_set_suit_counts(card_set_t set) {
+    uint64_t x = set - ((set >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (x + (x >> 8)) & 0x00ff00ff00ff00ffull;
+}
+
+/**
+ * @brief finds a suit holding five or more cards without branching on each suit
+ *
+ * @return the flush suit, or -1 if there is none. with 7 cards there can only be one
+ */
+static inline int card_set_flush_suit(card_set_t set) {
+    // adding 11 carries a lane into bit 4 exactly when it holds 5 or more cards
+    uint64_t flush = (card_set_suit_counts(set) + 11 * CARD_SET_LANE_ONES) & (16 * CARD_SET_LANE_ONES);
+    return flush ? __builtin_ctzll(flush) / CARD_SET_LANE_BITS : -1;
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef DECK_H
+#define DECK_H
+
+#include "poker_client.h"  // for card_t
+#include "macros.h"        // for DECK_SIZE
+#include "rng.h"           // for rng_t
+
+/**
+ * @brief a deck that only shuffles as far as cards are actually dealt
+ *
+ * a six handed hand that ends preflop deals 12 cards and one that reaches the river deals 17,
+ * so instead of shuffling all 52 cards at the start of every hand, deck_draw runs one step of
+ * Fisher-Yates per card it hands out. the cards left in the deck stay in whatever order the
+ * last hand left them, which is fine since every step picks uniformly among all of them.
+ *
+ * with an RNG_LEGACY generator the deck is shuffled up front by rng_shuffle_deck instead, so
+ * seeded games deal exactly the cards they always did.
+ */
+typedef struct {
+    card_t cards[DECK_SIZE];
+    int dealt;                  // how many cards have been dealt this hand
+    rng_t rng;
+} deck_t;
+
+/**
+ * @brief puts the cards in order (like init_deck) and seeds the deck's generator
+ */
+void deck_init(deck_t *deck, rng_mode_t mode, uint64_t seed);
+
+/**
+ * @brief reseeds the deck's generator, leaving the cards where they are
+ */
+void deck_seed(deck_t *deck, rng_mode_t mode, uint64_t seed);
+
+/**
+ * @brief collects every card back for a new hand
+ */
+void deck_reset(deck_t *deck);
+
+/**
+ * @brief deals the next card
+ *
+ * @return a uniformly random card out of the ones still in the deck, NOCARD if it is empty
+ */
+card_t deck_draw(deck_t *deck);
+
+/**
+ * @brief how many cards can still be dealt this hand
+ */
+int deck_remaining(const deck_t *deck);
+
+#endif
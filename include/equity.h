@@ -0,0 +1,99 @@
+#ifndef EQUITY_H
+#define EQUITY_H
+
+#include <stdint.h>
+#include "poker_client.h"  // for card_t
+#include "game_logic.h"    // for MAX_COMMUNITY_CARDS, HAND_SIZE
+
+// boards left to deal up to which equity_calculate enumerates them all instead of sampling
+#define EQUITY_EXACT_LIMIT 250000
+// boards a Monte Carlo run samples when the request sets neither iterations nor time_limit
+#define EQUITY_DEFAULT_ITERATIONS 200000
+// seed of the all-in equity the server prints, fixed so a replayed game prints the same numbers
+#define EQUITY_SERVER_SEED 0x5eedull
+
+/**
+ * @brief what equity_calculate works out the equity of
+ *
+ * zero in any of the tuning fields picks the default
+ */
+typedef struct {
+    int num_players;                                // how many hands are in hole_cards, 2 to MAX_PLAYERS
+    card_t hole_cards[MAX_PLAYERS][HAND_SIZE];      // known hole cards of every player still in the hand
+    card_t board[MAX_COMMUNITY_CARDS];              // the community cards dealt so far
+    int num_board;                                  // 0 (preflop), 3 (flop), 4 (turn) or 5 (river)
+    const card_t *dead_cards;                       // cards known to be out of the deck, e.g. folded hands
+    int num_dead;
+
+    long exact_limit;       // enumerate when at most this many boards are left, EQUITY_EXACT_LIMIT by default
+    long iterations;        // boards to sample when not enumerating, EQUITY_DEFAULT_ITERATIONS by default
+    double time_limit;      // seconds to stop sampling after, no limit by default
+    int num_threads;        // threads to spread the work over, the online cores by default
+    uint64_t seed;          // the same seed and iterations always give the same result
+} equity_request_t;
+
+/**
+ * @brief equity of every player, in the same order as the request's hole_cards
+ */
+typedef struct {
+    double equity[MAX_PLAYERS];     // share of the pot won on average, ties split evenly
+    double win[MAX_PLAYERS];        // share of boards won outright
+    double tie[MAX_PLAYERS];        // share of boards split with at least one other player
+    long boards;                    // how many boards were scored
+    int exact;                      // 1 if every remaining board was enumerated, 0 if sampled
+} equity_result_t;
+
+/**
+ * @brief works out the all-in equity of every player from the cards that are known
+ *
+ * every board that can still come is dealt out of the cards that are neither in a hand, on the
+ * board nor dead. when there are at most exact_limit of them they are all scored, otherwise
+ * boards are sampled until the iteration budget or the time limit runs out, whichever is first.
+ * the boards are split into fixed chunks each with its own seed, so a sampled result only
+ * depends on the seed and the number of boards, never on the number of threads. a time limit
+ * decides how many chunks get done, so only results without one are reproducible. the threads
+ * are started for the call and joined before it returns.
+ *
+ * hands are scored with the showdown evaluator, so ties and kickers work exactly like find_winner
+ *
+ * @param request the known cards and how to spend the work
+ * @param result filled with the equity of every player
+ * @return 0 on success, -1 if the request is invalid (bad player count, duplicate cards...) or
+ *         no thread could be started
+ */
+int equity_calculate(const equity_request_t *request, equity_result_t *result);
+
+// requests equity_submit can hold before it turns new ones away
+#define EQUITY_QUEUE_SIZE 64
+
+/**
+ * @brief called on the equity thread with the result of a request handed to equity_submit
+ * @param request the request as it was submitted
+ * @param result its result, NULL if the request was invalid
+ * @param data the data given to equity_submit
+ */
+typedef void (*equity_done_t)(const equity_request_t *request, const equity_result_t *result, void *data);
+
+/**
+ * @brief starts the thread that works out the requests of equity_submit
+ * it takes the CPU affinity of the thread that starts it, so start it before pinning anything
+ * @return 0 on success, -1 if the thread could not be started
+ */
+int equity_service_start(void);
+
+/**
+ * @brief works out the requests still queued, then stops the equity thread
+ */
+void equity_service_stop(void);
+
+/**
+ * @brief works out a request on the equity thread instead of the caller's
+ * the request is copied, dead cards included. done is not called for a request that is turned away
+ * @param request the known cards and how to spend the work, as for equity_calculate
+ * @param done called on the equity thread once the request is worked out
+ * @param data passed on to done
+ * @return 0 if queued, -1 if the equity thread is not running or EQUITY_QUEUE_SIZE requests are waiting
+ */
+int equity_submit(const equity_request_t *request, equity_done_t done, void *data);
+
+#endif
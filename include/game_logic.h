@@ -3,9 +3,13 @@
 #include <assert.h>
 #include "poker_client.h"  // for card_t, player_id_t
 #include "macros.h"        // for constants like MAX_PLAYERS
+#include "hand_eval.h"     // for hand_board_t
+#include "deck.h"          // for deck_t
+#include "reactor.h"       // for packet_queue_t
 
 #define MAX_COMMUNITY_CARDS 5
 #define HAND_SIZE 2
+#define RECV_TIMEOUT -2 // for betting_act, the player did not act in time
 
 typedef enum {
     PLAYER_FOLDED = 0,
@@ -24,11 +28,24 @@ typedef enum {
     ROUND_SHOWDOWN = 6
 } round_stage_t;
 
+typedef enum {
+    BETTING_OPEN = -1,   // waiting on game->current_player
+    BETTING_DONE = 0,    // everyone had a chance to RAISE
+    BETTING_FOLDED = 1   // all but one player folded, the hand ends
+} betting_result_t;
+
+// Where the betting on a street is, between two actions
 typedef struct {
+    int active;   // players who have not folded or gone all-in
+    int to_act;   // actions in a row that end the betting, reset by a RAISE
+    int turn;     // actions in a row so far
+} betting_t;
+
+typedef struct game_state {
     card_t player_hands[MAX_PLAYERS][HAND_SIZE];   // each player’s 2 cards
     card_t community_cards[MAX_COMMUNITY_CARDS];   // shared cards on table
-    card_t deck[DECK_SIZE];                        // main deck
-    int next_card;                                 // index of the next card to be drawn
+    hand_board_t board;                            // community cards folded in street by street for the evaluator
+    deck_t deck;                                   // main deck, shuffled by this table's own generator as cards are dealt
     int player_stacks[MAX_PLAYERS];                // how many chips each player has
     int current_bets[MAX_PLAYERS];                 // amount bet this round
     int highest_bet;                               // highest bet to call to
@@ -39,16 +56,27 @@ typedef struct {
     round_stage_t round_stage;                     // init/preflop/flop/turn/river/showdown
     int num_players;                               // total players in game
     int sockets[MAX_PLAYERS];                      // sockets for each player
+    packet_queue_t inbox[MAX_PLAYERS];             // packets each player sent that were not handled yet
+    betting_t betting;                             // the betting on the current street
+    int turn_timeout_ms;                           // how long a player has to act before they check or fold, 0 for no limit
+    ssize_t (*send_packet)(struct game_state *game, player_id_t pid, const server_packet_t *pkt); // sends pid a packet, a plain send() if NULL
 } game_state_t;
 
 void init_game_state(game_state_t *game, int starting_stack, int random_seed);
+void seed_game_rng(game_state_t *game, rng_mode_t mode, uint64_t seed);
 void reset_game_state(game_state_t *game);
 void print_game_state(game_state_t *game); // for debugging
 void init_deck(card_t deck[DECK_SIZE], int seed); 
 void shuffle_deck(card_t deck[DECK_SIZE]);
 int check_betting_end(game_state_t *game);
+ssize_t send_server_packet(game_state_t *game, player_id_t pid, const server_packet_t *pkt);
+int betting_start(game_state_t *game);
+int betting_act(game_state_t *game, client_packet_t *received_packet, int received);
 int find_winner(game_state_t *game);
+void log_allin_equity(game_state_t *game);
 int evaluate_hand(game_state_t *game, player_id_t pid);
+int evaluate_hand_combinations(card_t all_cards[7]);
+int current_best_hand(game_state_t *game, player_id_t pid);
 int calculate_5card_value(card_t current_hand[]);
 int set_card_tie(int final_points, int ranks[]);
 void sort_cards(card_t *val);
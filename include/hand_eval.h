@@ -0,0 +1,163 @@
+#ifndef HAND_EVAL_H
+#define HAND_EVAL_H
+
+#include "poker_client.h"  // for card_t
+#include "card_set.h"      // for card_set_t
+
+#define HAND_EVAL_CARDS 7
+#define HAND_EVAL_BOARD_CARDS 5
+
+// precomputed tables written by `make tables`, bump the version whenever their layout changes
+#define HAND_EVAL_TABLES_VERSION 1
+#define HAND_EVAL_TABLES_PATH "build/hand_eval.v1.tables"
+#define HAND_EVAL_TABLES_ENV "POKER_HAND_EVAL_TABLES"  // overrides HAND_EVAL_TABLES_PATH if set
+
+/**
+ * @brief the board as it is dealt street by street, kept so a showdown only adds the hole cards
+ *
+ * key folds the rank counts of the board into one partial perfect hash key and suit_counts holds
+ * one byte per suit. best_score is the best hand made by the board cards alone
+ */
+typedef struct {
+    uint32_t key;              // summed rank keys of the board cards
+    uint32_t suit_counts;      // number of board cards of each suit, one byte per suit
+    card_set_t cards;          // the board cards, i.e. the 13 bit rank mask of every suit
+    int num_cards;             // how many cards have been dealt to the board so far
+    int best_score;            // best hand on the board by itself, same encoding as hand_eval7
+} hand_board_t;
+
+/**
+ * @brief the code paths hand_eval_batch can run, picked at runtime from what the cpu supports
+ */
+typedef enum {
+    HAND_EVAL_KERNEL_SCALAR = 0,
+    HAND_EVAL_KERNEL_SSE4 = 1,
+    HAND_EVAL_KERNEL_AVX2 = 2
+} hand_eval_kernel_t;
+
+/**
+ * @brief builds the lookup tables used by hand_eval7 and hand_eval_card_set
+ *
+ * the large seven card table is not built here but mapped read-only from the file at
+ * HAND_EVAL_TABLES_PATH (or $POKER_HAND_EVAL_TABLES), so all processes on a host share it.
+ * if the file is missing or does not match this build, see hand_eval_tables_loaded.
+ *
+ * safe to call more than once and from several threads, only the first call does any work
+ */
+void hand_eval_init(void);
+
+/**
+ * @brief whether hand_eval_init managed to map the precomputed table file
+ *
+ * without it every evaluator still returns the same scores but takes the slower card set path
+ * and the batch functions run the scalar kernel
+ *
+ * @return 1 if the tables are mapped, 0 otherwise
+ */
+int hand_eval_tables_loaded(void);
+
+/**
+ * @brief builds the seven card tables and writes them to a file hand_eval_init can map
+ *
+ * the file is written under a temporary name and renamed into place, so processes starting
+ * at the same time never map a partial file
+ *
+ * @param path where to write the tables
+ * @return 0 on success, -1 if the file could not be written
+ */
+int hand_eval_write_tables(const char *path);
+
+/**
+ * @brief scores the best five card hand out of seven cards with a couple of table probes
+ *
+ * the score uses the same encoding as calculate_5card_value:
+ *      [HAND_RANK]20 [Tie1]16 [Tie2]12 [Tie3]8 [Tie4]4 [Tie5]0
+ * so two scores can be compared directly with < and >
+ *
+ * @param cards the seven cards to score, none of them may be NOCARD
+ * @return the score of the best hand
+ */
+int hand_eval7(const card_t cards[HAND_EVAL_CARDS]);
+
+/**
+ * @brief scores the best hand in a card set without sorting or looping over combinations
+ *
+ * flushes are found from the per suit popcounts and straights with a lookup on the 13 bit rank
+ * mask. works for up to seven cards, where a flush rules out quads and a full house and only one
+ * suit can flush. sets smaller than five score like a partial hand (e.g. three cards of a flop
+ * with a pair score as that pair). uses the same encoding as hand_eval7
+ *
+ * @param cards the cards to score, at most HAND_EVAL_CARDS of them
+ * @return the score of the best hand
+ */
+int hand_eval_card_set(card_set_t cards);
+
+/**
+ * @brief scores many hands that share the same five board cards
+ *
+ * every hand is the board plus one pair of hole cards, scored exactly like hand_eval7 would.
+ * num_hands can be anything from a single showdown to thousands of hands for simulations.
+ * calls hand_eval_init if nothing did yet
+ *
+ * @param board the five community cards
+ * @param hole_cards num_hands pairs of hole cards
+ * @param num_hands how many pairs to score
+ * @param scores filled with one score per pair, in the same order
+ */
+void hand_eval_batch(const card_t board[HAND_EVAL_BOARD_CARDS], const card_t hole_cards[][2],
+                     int num_hands, int scores[]);
+
+/**
+ * @brief same as hand_eval_batch but forces a kernel, e.g. to benchmark one against another
+ *
+ * a kernel the cpu does not support is replaced by the best one it does. calls hand_eval_init if
+ * nothing did yet
+ */
+void hand_eval_batch_kernel(hand_eval_kernel_t kernel, const card_t board[HAND_EVAL_BOARD_CARDS],
+                            const card_t hole_cards[][2], int num_hands, int scores[]);
+
+/**
+ * @brief scores many hands against a board built with hand_board_add
+ *
+ * with a full board this is hand_eval_batch minus the work of summing the board, on earlier
+ * streets every hand is scored like hand_board_score
+ *
+ * requires hand_eval_init to have been called, as hand_board_add does
+ */
+void hand_eval_batch_board(hand_eval_kernel_t kernel, const hand_board_t *board,
+                           const card_t hole_cards[][2], int num_hands, int scores[]);
+
+/**
+ * @brief empties a board, e.g. at the start of a hand
+ */
+void hand_board_reset(hand_board_t *board);
+
+/**
+ * @brief deals one more card to the board and rescores the board on its own
+ *
+ * requires hand_eval_init to have been called
+ */
+void hand_board_add(hand_board_t *board, card_t card);
+
+/**
+ * @brief the best hand a player holds with the board as it stands on the current street
+ *
+ * cheap enough to call on every street, e.g. to show a player what they have made so far
+ *
+ * @param board the board dealt so far, anything from 0 to 5 cards
+ * @param hole the player's two hole cards
+ * @return the score, same encoding as hand_eval7
+ */
+int hand_board_score(const hand_board_t *board, const card_t hole[2]);
+
+/**
+ * @brief the fastest kernel the cpu supports, which is what hand_eval_batch runs
+ */
+hand_eval_kernel_t hand_eval_best_kernel(void);
+
+/**
+ * @brief printable name of a kernel
+ */
+const char *hand_eval_kernel_name(hand_eval_kernel_t kernel);
+
+#endif
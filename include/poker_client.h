@@ -47,6 +47,21 @@ const wchar_t *fancy_card_name(card_t card);
  */
 int connect_to_serv(player_id_t player_id);
 
+/**
+ * @brief connect to the server's single port and ask for a seat at a table
+ * 
+ * the server answers the JOIN with an ACK telling where the player sat down, or a NACK if the
+ * seat or table is not free. the JOIN offers the compact wire format, which every packet after
+ * the ACK is in if the server agreed to it, and the raw structs otherwise
+ * 
+ * @param table the table to sit down at, JOIN_ANY for the first one with a free seat. set to the
+ *              table the player sat down at on success
+ * @param seat the seat to take, JOIN_ANY for any free one. set to the seat taken on success,
+ *             it is the player_id to play as
+ * @return 0 on success, -1 otherwise
+ */
+int connect_to_table(int *table, player_id_t *seat);
+
 /**
  * @brief gracefully disconnect from the server
  *  
@@ -65,18 +80,39 @@ typedef enum client_packet_type
     RAISE,      // raise the bet
     CALL,       // call the bet 
     CHECK,      // check
-    FOLD        // fold hand
+    FOLD,       // fold hand
+    SNAPSHOT    // have the table send an INFO in full rather than as a delta, right away
 } client_packet_type_t;
 
 typedef struct client_packet
 {
     client_packet_type_t packet_type;
     int params[MAX_CLIENT_PACKET_PARAMS];
+    unsigned seq; // numbers the packet for the ACK or NACK that answers it, from WIRE_SEQ on. never sent raw
 } client_packet_t;
 
+/**
+ * params[0] of a JOIN: 0 takes the seat of the port connected to, without an answer, while a
+ * JOIN_REQUEST asks for a seat and table on any port and is answered with an ACK or NACK
+ * 
+ * bits 0-3 hold the seat + 1 and bits 8-29 the table + 1, with 0 for any. bits 4-7 of a
+ * JOIN_REQUEST hold the newest wire format the client speaks (see wire.h), 0 for the raw structs
+ */
+#define JOIN_ANY -1
+#define JOIN_REQUEST_FLAG (1 << 30)
+#define JOIN_REQUEST(table, seat) (JOIN_REQUEST_FLAG | (((table) + 1) << 8) | ((seat) + 1))
+#define JOIN_REQUEST_TABLE(param) ((((param) >> 8) & 0x3fffff) - 1)
+#define JOIN_REQUEST_SEAT(param) (((param) & 0xf) - 1)
+#define JOIN_WIRE(version) (((version) & 0xf) << 4)
+#define JOIN_REQUEST_WIRE(param) (((param) >> 4) & 0xf)
+
 /**
  * @brief sends a packet to the connected server, then waits for a response
  * 
+ * an INFO, END or HALT that arrives first goes to its handler. from WIRE_SEQ on the response is
+ * the ACK or NACK with the packet's number, and the ones that answer packets of send_packet_async
+ * go to theirs, before that it is the first ACK or NACK
+ * 
  * @param pkt the packet contents to send to the server
  * @return 0 on success (ACK response), -1 on failure
  */
@@ -124,6 +160,24 @@ typedef struct
     int player_status[MAX_PLAYERS]; //1 for in hand, 0 for folded, 2 for left
 } end_packet_t;
 
+/**
+ * @brief where a player sat down, in the ACK to a JOIN_REQUEST
+ */
+typedef struct
+{
+    int table;
+    player_id_t seat;
+    int wire; // the wire format of every packet after this ACK, both ways
+} join_packet_t;
+
+/**
+ * @brief which packet an ACK or NACK answers, from WIRE_SEQ on
+ */
+typedef struct
+{
+    unsigned seq; // the seq of the client packet it answers, 0 for an action the server took for a player out of time
+} reply_packet_t;
+
 /**
  * @brief information about the packet recieved by the client 
  */
@@ -134,22 +188,47 @@ typedef struct server_packet
     {
         info_packet_t info;
         end_packet_t end;
+        join_packet_t join;
+        reply_packet_t reply;
     };
 } server_packet_t;
 
 /**
  * @brief waits for a packet from the server.
  * 
+ * an ACK or NACK that answers a packet of send_packet_async goes to its reply handler
+ * 
  * @param pkt the memory to store the packet information
  * @return 0 if packet recieved, -1 on failure
  */
 int recv_packet(server_packet_t *pkt);
 
+/**
+ * @brief handles whatever the server sent so far without waiting for more
+ * 
+ * every whole packet goes to its handler the way recv_packet hands it over, and a packet that
+ * only partly arrived waits in the library for the rest. meant to be called whenever client_fd
+ * turns readable in an event loop of the caller's
+ * 
+ * @return the number of packets handled, 0 if none was whole yet, -1 once the connection closed
+ */
+int poll_packets();
+
+/**
+ * @brief the socket of the connection, for an event loop to wait on
+ * 
+ * it stays a blocking socket, poll_packets reads it without waiting by itself
+ * 
+ * @return the socket, -1 if not connected
+ */
+int client_fd();
+
 // ---------------------------- poker operations ---------------------------- //
 
 typedef void(*info_packet_handler_t)(info_packet_t*);
 typedef void(*end_packet_handler_t)(end_packet_t*);
 typedef void(*on_halt_packet_handler_t)();
+typedef void(*reply_packet_handler_t)(unsigned seq, int acked, void *data);
 
 /**
  * @brief set the handler that is called whenver an info packet is received 
@@ -174,6 +253,20 @@ void set_on_end_packet_handler(end_packet_handler_t handler);
  */
 void set_on_halt_packet_handler(end_packet_handler_t handler);
 
+/**
+ * @brief sends a packet without waiting for its response, to pipeline actions
+ *
+ * every packet is numbered and the server answers with the same number, so the ACK or NACK
+ * is matched to its packet whatever arrives in between. recv_packet hands it to the handler,
+ * acked 1 for an ACK and 0 for a NACK, and INFO, END and HALT to theirs as always. READY, LEAVE
+ * and SNAPSHOT have no response, so their handler is never called. needs a connection that
+ * agreed to WIRE_SEQ or later at connect_to_table
+ *
+ * @param handler called with the packet's number and data once the response arrived, may be NULL
+ * @return the packet's number, 0 on failure or with too many packets waiting for a response
+ */
+unsigned send_packet_async(client_packet_t *pkt, reply_packet_handler_t handler, void *data);
+
 /**
  * @brief the player states they are ready
  * 
@@ -228,6 +321,17 @@ int fold();
  */
 int leave();
 
+/**
+ * @brief asks the table to send an info packet in full right away
+ * 
+ * the library rebuilds every info packet whole either way, a delta is only what the wire carries
+ * (see WIRE_DELTA). this is a resync for a client that lost track, it has no answer but the info
+ * packet, which between hands is the first one of the next hand
+ * 
+ * @return 0 if successful, -1 if failure
+ */
+int request_snapshot();
+
 /**
  * @brief check if it is the players turn based on the most recent info packet
  * 
@@ -242,4 +346,62 @@ int is_players_turn(player_id_t player_id);
  */
 int has_recv_halt();
 
+// ---------------------------- connections ---------------------------- //
+
+/**
+ * @brief one connection to the server, with its own handlers and everything it received
+ *
+ * every function above plays one seat on a connection of the library's own. each of them has a
+ * poker_ twin that takes the connection instead, so one process can play any number of seats,
+ * from any number of threads as long as no two of them use the same connection at once
+ */
+typedef struct poker_conn poker_conn_t;
+
+typedef void(*poker_info_handler_t)(poker_conn_t *conn, info_packet_t *info);
+typedef void(*poker_end_handler_t)(poker_conn_t *conn, end_packet_t *end);
+typedef void(*poker_halt_handler_t)(poker_conn_t *conn);
+
+/**
+ * @brief makes a connection that is not connected yet
+ *
+ * @return the connection, NULL if out of memory
+ */
+poker_conn_t *poker_conn_create(void);
+
+/**
+ * @brief disconnects a connection if it still is and frees it
+ */
+void poker_conn_destroy(poker_conn_t *conn);
+
+/**
+ * @brief keeps a pointer with the connection, for its handlers to find their seat's state
+ */
+void poker_conn_set_data(poker_conn_t *conn, void *data);
+
+/**
+ * @brief the pointer given to poker_conn_set_data, NULL before that
+ */
+void *poker_conn_data(poker_conn_t *conn);
+
+int poker_connect_to_serv(poker_conn_t *conn, player_id_t player_id);
+int poker_connect_to_table(poker_conn_t *conn, int *table, player_id_t *seat);
+int poker_disconnect_to_serv(poker_conn_t *conn);
+int poker_send_packet(poker_conn_t *conn, client_packet_t *pkt);
+unsigned poker_send_packet_async(poker_conn_t *conn, client_packet_t *pkt, reply_packet_handler_t handler, void *data);
+int poker_recv_packet(poker_conn_t *conn, server_packet_t *pkt);
+int poker_poll_packets(poker_conn_t *conn);
+int poker_client_fd(poker_conn_t *conn);
+void poker_set_on_info_packet_handler(poker_conn_t *conn, poker_info_handler_t handler);
+void poker_set_on_end_packet_handler(poker_conn_t *conn, poker_end_handler_t handler);
+void poker_set_on_halt_packet_handler(poker_conn_t *conn, poker_halt_handler_t handler);
+int poker_ready(poker_conn_t *conn);
+int poker_check(poker_conn_t *conn);
+int poker_bet_raise(poker_conn_t *conn, int new_bet);
+int poker_call(poker_conn_t *conn);
+int poker_fold(poker_conn_t *conn);
+int poker_leave(poker_conn_t *conn);
+int poker_request_snapshot(poker_conn_t *conn);
+int poker_is_players_turn(poker_conn_t *conn, player_id_t player_id);
+int poker_has_recv_halt(poker_conn_t *conn);
+
 #endif
\ No newline at end of file
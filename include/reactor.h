@@ -0,0 +1,201 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <sys/types.h>
+#include "poker_client.h"  // for client_packet_t
+
+// packets a connection can have waiting, a table hangs up on a player who sends more
+#define PACKET_QUEUE_SIZE 16
+
+/**
+ * @brief the packets one connection sent that were not handled yet, oldest first
+ *
+ * one thread may push while another pops without a lock, as long as there is only one of each
+ */
+typedef struct {
+    client_packet_t packets[PACKET_QUEUE_SIZE];
+    unsigned head;  // packets popped so far
+    unsigned tail;  // packets pushed so far
+    int closed;     // set once the connection is gone, the packets already queued can still be popped
+} packet_queue_t;
+
+/**
+ * @brief adds a packet to the back of a queue
+ *
+ * @return 0 on success, -1 if the queue is full and the packet was not queued
+ */
+int packet_queue_push(packet_queue_t *queue, const client_packet_t *pkt);
+
+/**
+ * @brief takes the packet at the front of a queue
+ *
+ * @return 0 on success, -1 if the queue is empty
+ */
+int packet_queue_pop(packet_queue_t *queue, client_packet_t *pkt);
+
+/**
+ * @brief whether a queue has no packets left
+ */
+int packet_queue_empty(const packet_queue_t *queue);
+
+/**
+ * @brief marks the connection of a queue as gone
+ */
+void packet_queue_close(packet_queue_t *queue);
+
+/**
+ * @brief whether the connection of a queue is gone
+ */
+int packet_queue_closed(const packet_queue_t *queue);
+
+typedef struct reactor reactor_t;
+
+/**
+ * @brief how a reactor talks to the kernel, picked when it is created
+ */
+typedef enum {
+    REACTOR_EPOLL = 0,      // epoll_wait, then one read() per readable socket and one send() per packet
+    REACTOR_IO_URING = 1    // multishot accept and recv into provided buffers, sends submitted in batches
+} reactor_backend_t;
+
+/**
+ * @brief called for every connection a listening socket accepts
+ *
+ * the new socket is not watched yet, reactor_add it to get its packets
+ *
+ * @param data what the listening socket was registered with
+ */
+typedef void (*reactor_accept_fn)(reactor_t *reactor, int listen_fd, int fd, void *data);
+
+/**
+ * @brief called for every complete packet a connection sends, in the order they arrive
+ *
+ * @param data what the connection was registered with
+ */
+typedef void (*reactor_packet_fn)(reactor_t *reactor, int fd, const client_packet_t *pkt, void *data);
+
+/**
+ * @brief called once when a connection is closed by the other side or fails
+ *
+ * the connection is no longer watched when this is called, but it is not closed
+ */
+typedef void (*reactor_close_fn)(reactor_t *reactor, int fd, void *data);
+
+/**
+ * @brief creates a reactor, which owns the listening and client sockets added to it
+ *
+ * one thread polls a reactor, but any thread may add and remove sockets or wake it up. the
+ * callbacks run on the polling thread, and may add and remove sockets of the same reactor
+ *
+ * the reactor accepts connections on its listening sockets and hands them to on_accept. it reads
+ * whatever arrived on any of its client sockets, puts the bytes back together into whole
+ * client_packet_ts however the stream split them, and hands each one to on_packet
+ *
+ * @param backend REACTOR_IO_URING needs a kernel with multishot recv, 6.0 or later
+ * @return the new reactor, NULL on failure
+ */
+reactor_t *reactor_create(reactor_backend_t backend, reactor_accept_fn on_accept, reactor_packet_fn on_packet,
+                          reactor_close_fn on_close);
+
+/**
+ * @brief whether the kernel supports a backend, for picking one at startup
+ */
+int reactor_backend_available(reactor_backend_t backend);
+
+/**
+ * @brief stops watching every socket and frees the reactor, the sockets are left open
+ */
+void reactor_destroy(reactor_t *reactor);
+
+/**
+ * @brief starts watching a connected client socket
+ *
+ * @param data handed back to on_packet and on_close for this socket
+ * @return 0 on success, -1 on failure
+ */
+int reactor_add(reactor_t *reactor, int fd, void *data);
+
+/**
+ * @brief watches a connected client socket for its next packet only
+ *
+ * not a byte past that packet is read, and the socket is no longer watched once the packet
+ * was handed to on_packet, so it can go on to another reactor with the rest of its stream
+ *
+ * @param data handed back to on_packet and on_close for this socket
+ * @return 0 on success, -1 on failure
+ */
+int reactor_expect(reactor_t *reactor, int fd, void *data);
+
+/**
+ * @brief starts accepting connections on a listening socket
+ *
+ * @param data handed back to on_accept for this socket
+ * @return 0 on success, -1 on failure
+ */
+int reactor_listen(reactor_t *reactor, int listen_fd, void *data);
+
+/**
+ * @brief stops watching a socket and drops the part of a packet read from it so far
+ *
+ * the socket is left open, close it afterwards
+ */
+void reactor_remove(reactor_t *reactor, int fd);
+
+/**
+ * @brief stops watching a socket that went away or broke the protocol and tells on_close
+ *
+ * for the thread that polls the reactor, e.g. from a packet handler. the socket is left open
+ */
+void reactor_hang_up(reactor_t *reactor, int fd);
+
+/**
+ * @brief sets the wire format (see wire.h) the packets of a watched socket come in from now on
+ *
+ * sockets start out with the raw structs
+ */
+void reactor_set_wire(reactor_t *reactor, int fd, int wire);
+
+/**
+ * @brief sends bytes on one of the reactor's client sockets
+ *
+ * the bytes are queued behind whatever the socket has queued already and go out at the next
+ * reactor_flush or reactor_poll: the epoll backend with one send() per socket, the io_uring
+ * backend with one system call for all of its sockets. bytes queued for a socket that is removed
+ * are still sent, as far as its socket buffer takes them. a socket the reactor does not watch gets
+ * a plain send()
+ *
+ * the sockets must not block. what a full socket buffer does not take waits until the socket is
+ * writable again, and a socket whose reader falls too far behind is shut down so it is hung up on
+ *
+ * safe to call from any thread
+ *
+ * @return len on success, -1 on failure
+ */
+ssize_t reactor_send(reactor_t *reactor, int fd, const void *buf, size_t len);
+
+/**
+ * @brief starts sending everything reactor_send queued, e.g. once a table waits for its next packet
+ *
+ * safe to call from any thread
+ */
+void reactor_flush(reactor_t *reactor);
+
+/**
+ * @brief makes a reactor_poll that is waiting, or the next one, return right away
+ *
+ * safe to call from any thread
+ */
+void reactor_wakeup(reactor_t *reactor);
+
+/**
+ * @brief waits until at least one socket is readable and dispatches everything that arrived
+ *
+ * new connections go to on_accept, packets to on_packet and closed connections to on_close.
+ * a reactor_wakeup also ends the wait
+ *
+ * @param timeout_ms how long to wait, -1 to wait forever
+ * @return the number of packets dispatched, -1 on failure
+ */
+int reactor_poll(reactor_t *reactor, int timeout_ms);
+
+#endif
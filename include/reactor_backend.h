@@ -0,0 +1,85 @@
+#ifndef REACTOR_BACKEND_H
+#define REACTOR_BACKEND_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "reactor.h"
+#include "wire.h"
+
+// bytes read at once, enough for many packets that arrived together
+#define READ_SIZE (16 * sizeof(client_packet_t))
+// bytes a socket can have waiting to be sent before its reader is given up on
+#define MAX_BACKLOG (256 * sizeof(server_packet_t))
+
+// A socket the reactor watches, with the part of a packet read from it so far
+typedef struct {
+    int in_use;
+    int listening;
+    int once;           // stop watching after the next packet, see reactor_expect
+    uint32_t gen;       // counts the sockets that had this fd, so a backend can tell a late completion from a new socket
+    void *data;
+    int wire;           // the format packets come in, see wire.h
+    size_t fill;
+    uint8_t partial[sizeof(client_packet_t)];   // no packet is longer in any format
+    void *out;          // the backend's bytes still to be sent, if it queues them
+} conn_t;
+
+/**
+ * @brief what a backend does for the reactor, always with the reactor's lock held except for poll
+ */
+typedef struct {
+    int (*init)(reactor_t *reactor);
+    void (*destroy)(reactor_t *reactor);
+    int (*watch)(reactor_t *reactor, int fd, conn_t *conn);                // start accepting or reading
+    void (*unwatch)(reactor_t *reactor, int fd, conn_t *conn);             // stop, the socket is closed right after
+    ssize_t (*send)(reactor_t *reactor, int fd, conn_t *conn, const void *buf, size_t len);
+    void (*flush)(reactor_t *reactor);
+    int (*poll)(reactor_t *reactor, int timeout_ms);                       // takes the lock itself to dispatch
+} reactor_ops_t;
+
+struct reactor {
+    const reactor_ops_t *ops;
+    void *backend;
+    int wakeup_fd;      // an eventfd that reactor_wakeup makes readable
+    pthread_mutex_t lock;   // held while sockets are added or removed and while events are dispatched, recursive for the callbacks
+    reactor_accept_fn on_accept;
+    reactor_packet_fn on_packet;
+    reactor_close_fn on_close;
+    conn_t *conns;      // indexed by fd
+    int num_conns;
+};
+
+extern const reactor_ops_t reactor_epoll_ops;
+extern const reactor_ops_t reactor_uring_ops;
+
+/**
+ * @brief whether the kernel can run the io_uring backend
+ */
+int reactor_uring_available(void);
+
+/**
+ * @brief the connection of a watched socket, NULL if the reactor does not watch it
+ */
+conn_t *reactor_conn(reactor_t *reactor, int fd);
+
+/**
+ * @brief empties the wakeup eventfd once it woke the reactor up
+ */
+void reactor_drain_wakeup(reactor_t *reactor);
+
+/**
+ * @brief hands a connection a listening socket accepted to on_accept
+ */
+void reactor_accepted(reactor_t *reactor, int listen_fd, int fd);
+
+/**
+ * @brief puts the bytes read from a socket back together into packets and dispatches them, in its wire format
+ *
+ * stops at the packet of a reactor_expect socket, the caller never reads past it. a socket that
+ * sends something that is no packet is hung up on
+ *
+ * @return the number of packets dispatched
+ */
+int reactor_deliver(reactor_t *reactor, int fd, const char *buf, size_t nbytes);
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+#include "poker_client.h"  // for card_t
+#include "macros.h"        // for DECK_SIZE
+
+/**
+ * @brief the generators a table can shuffle its deck with
+ *
+ * RNG_LEGACY replays the sequence of glibc's srand()/rand() from the table's own state, so a
+ * table shuffles exactly like init_deck and shuffle_deck did without touching the global rand()
+ * state. RNG_XOSHIRO is xoshiro256**, much faster and with far better statistics, and shuffles
+ * with an unbiased Fisher-Yates instead. Both are reproducible from their seed, which is what
+ * tests and replays want and exactly what a real money table must not be.
+ *
+ * RNG_CHACHA is for real tables: ChaCha20 keyed from getrandom(), so shuffles cannot be predicted or
+ * replayed. it ignores the seed and keeps no state in the table, every thread has one generator
+ * that all the tables it runs draw from.
+ */
+typedef enum {
+    RNG_LEGACY = 0,
+    RNG_XOSHIRO = 1,
+    RNG_CHACHA = 2
+} rng_mode_t;
+
+#define RNG_LEGACY_DEGREE 31  // words of state of glibc's default TYPE_3 generator
+#define RNG_LEGACY_SEP 3      // distance between its front and rear pointers
+
+/**
+ * @brief the state of one generator, every table keeps its own
+ */
+typedef struct {
+    rng_mode_t mode;
+    union {
+        struct {
+            int32_t state[RNG_LEGACY_DEGREE];
+            int front;
+            int rear;
+        } legacy;
+        uint64_t xoshiro[4];
+    };
+} rng_t;
+
+/**
+ * @brief seeds a generator
+ *
+ * in RNG_LEGACY mode only the low 32 bits of the seed are used, exactly like srand(seed).
+ * RNG_CHACHA ignores the seed and never needs reseeding by hand
+ *
+ * @param rng the generator to seed
+ * @param mode which generator to run
+ * @param seed the seed, e.g. from rng_table_seed
+ */
+void rng_seed(rng_t *rng, rng_mode_t mode, uint64_t seed);
+
+/**
+ * @brief derives the seed of one table from the seed of the whole server
+ *
+ * the same master seed always gives every table the same seed, and tables never share a seed,
+ * so any table can be replayed on its own no matter how many others ran next to it
+ *
+ * @param master_seed the seed the server was started with
+ * @param table_id the table, starting at 0
+ * @return the seed to give rng_seed for that table
+ */
+uint64_t rng_table_seed(uint64_t master_seed, int table_id);
+
+/**
+ * @brief the next 32 random bits
+ *
+ * in RNG_LEGACY mode this is the next value rand() would have returned, 31 bits only
+ */
+uint32_t rng_next(rng_t *rng);
+
+/**
+ * @brief a uniform random number in [0, range)
+ */
+uint32_t rng_bounded(rng_t *rng, uint32_t range);
+
+/**
+ * @brief shuffles a deck in place
+ *
+ * in RNG_LEGACY mode this is the same swap loop as shuffle_deck, so seeded games deal the
+ * same cards as they always did. otherwise it is an unbiased Fisher-Yates shuffle
+ */
+void rng_shuffle_deck(rng_t *rng, card_t deck[DECK_SIZE]);
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include <pthread.h>
+#include "game_logic.h"  // for game_state_t
+#include "reactor.h"     // for reactor_t
+#include "rng.h"         // for rng_mode_t
+#include "wire.h"        // for wire_base_t
+#include "worker.h"      // for worker_t
+
+typedef enum {
+    TABLE_FREE = 0,     // in the free list, waiting to be reused
+    TABLE_SEATING = 1,  // players are sitting down, the hands start once every seat is taken or the deadline passed
+    TABLE_RUNNING = 2   // playing hands until fewer than two players are left
+} table_status_t;
+
+// Where a table is in its hands, between two packets
+typedef enum {
+    HAND_STARTING = 0,  // seated, the first hand begins on whichever worker runs the table first
+    HAND_INIT = 1,      // reading the READY or LEAVE of every seat in turn, waits on ready_seat
+    HAND_BETTING = 2,   // betting on the street in game.round_stage, waits on game.current_player
+    HAND_CLOSED = 3     // fewer than two players were left and every seat is closed
+} hand_state_t;
+
+/**
+ * @brief one table with its own game, dealer, deck and generator
+ *
+ * every table plays its hands as a state machine that only moves on when the packet of the
+ * seat it waits for arrives, the seat hangs up or the player's clock runs out. between two
+ * of those all there is to a table is this struct, so one thread runs any number of tables
+ * without a stack for each. a table belongs to the worker whose reactor has its sockets,
+ * but may be run by any worker
+ */
+typedef struct table {
+    game_state_t game;              // everything about the hands, first so a game_state_t * leads back here
+    int id;                         // counts up from 0 in the order tables fill up, and seeds the deck
+    table_status_t status;
+    int seated;                     // seats with a connection
+    int wire[MAX_PLAYERS];          // the wire format every seat's connection speaks, see wire.h
+    wire_base_t sent[MAX_PLAYERS];  // the last INFO every seat was sent, for the worker running the table
+    int snapshot_due[MAX_PLAYERS];  // the seat sent a SNAPSHOT, the table sends it a full INFO as soon as it runs. atomic
+    long seat_deadline;             // when it starts without every seat taken, in ms on the monotonic clock, 0 for never
+    worker_t *owner;
+    struct table_pool *pool;
+    struct table *next;             // next table in the free list or the seating list
+    hand_state_t state;
+    player_id_t ready_seat;         // the seat HAND_INIT waits on
+
+    pthread_mutex_t lock;           // guards the scheduling state below
+    player_id_t waiting_on;         // seat the table waits for a packet from, -1 if it can run
+    int queued;                     // on its owner's run queue
+    int running;                    // some worker is feeding it events
+    int wake;                       // woken up while running, goes back on the run queue once it waits
+    unsigned turn;                  // counts the packets and time outs the table handled
+    int clock_armed;                // turn_timer is on the owner's wheel
+    player_id_t clock_seat;         // the seat turn_timer runs for
+    unsigned clock_turn;            // the turn turn_timer was armed in, it runs out for nothing once the table moved on
+    int timed_out;                  // the clock of clock_seat ran out
+    wheel_timer_t turn_timer;       // the clock of the player whose turn it is, on the owner's wheel
+    struct table *run_next;         // next table on the run queue
+} table_t;
+
+/**
+ * @brief how a pool starts its tables
+ */
+typedef struct {
+    int starting_stack;
+    int seed;               // the master seed, every table's deck is seeded from it and the table's id
+    rng_mode_t rng_mode;
+    int max_tables;         // tables to play before the pool is done, 0 to keep playing forever
+    int num_workers;        // threads to run the tables on, 0 for one per core
+    int min_players;        // players a table needs to start before all its seats are taken
+    int join_deadline_ms;   // how long after it opens a table starts with min_players, 0 to wait for every seat
+    int turn_timeout_ms;    // how long a player has to act before they check or fold, or to say READY before they leave, 0 for no limit
+    reactor_backend_t backend;  // how the workers' reactors talk to the kernel
+} table_config_t;
+
+/**
+ * @brief every table of the server, and the workers that run them
+ */
+typedef struct table_pool {
+    table_config_t config;
+    reactor_t *acceptor;            // woken up whenever a table finishes
+    worker_t *workers;
+    int num_workers;
+
+    pthread_mutex_t lock;           // guards everything below
+    table_t *free_tables;           // finished tables kept to be reused
+    table_t *seating;               // tables players are sitting down at, oldest first
+    int tables_started;             // also the id of the next table to fill up
+    int tables_running;
+    int tables_allocated;
+} table_pool_t;
+
+/**
+ * @brief sets up an empty pool and starts its workers
+ *
+ * @param acceptor the reactor that accepts the pool's players, woken up when a table finishes
+ * @return 0 on success, -1 if the workers could not be started
+ */
+int table_pool_init(table_pool_t *pool, const table_config_t *config, reactor_t *acceptor);
+
+/**
+ * @brief stops the workers of a pool
+ */
+void table_pool_destroy(table_pool_t *pool);
+
+/**
+ * @brief sits a player who sent their JOIN down at a table
+ *
+ * without a table id, the player sits down at the first table filling up that has the seat free,
+ * or a new one if none has, which goes to the next worker in turn. the connection goes to the
+ * reactor of the table's worker. once its last seat is taken, or enough of them after its deadline,
+ * a table starts playing
+ *
+ * @param table_id the id of a table filling up, JOIN_ANY for the first one with the seat free
+ * @param seat the seat to take, JOIN_ANY for the first free one. set to the seat taken
+ * @param fd the player's socket, with nothing after the JOIN read from it yet
+ * @param wire the wire format the player's packets are in after the JOIN, both ways
+ * @return the table the player sat down at, NULL if the table or seat is not free or the pool
+ *         has started all of its tables
+ */
+table_t *table_pool_seat(table_pool_t *pool, int table_id, player_id_t *seat, int fd, int wire);
+
+/**
+ * @brief starts every seating table whose deadline passed with enough players sitting down
+ *
+ * for the thread that accepts, which a new table with a deadline wakes up
+ *
+ * @return ms until the next deadline, -1 if no table is waiting for one
+ */
+int table_pool_start_due(table_pool_t *pool);
+
+/**
+ * @brief moves a table's hand on with a packet from the seat it waits on
+ *
+ * @param pkt the packet, NULL if the seat hung up before sending one
+ */
+void table_on_packet(table_t *table, player_id_t seat, const client_packet_t *pkt);
+
+/**
+ * @brief moves a table's hand on once the player it waits on ran out of time
+ */
+void table_on_timer(table_t *table);
+
+/**
+ * @brief feeds a table the packets, hang ups and timeouts of the seat it waits on, until it has to wait
+ *
+ * for the worker running the table. the packets of other seats stay in their inbox until it is their turn
+ *
+ * @return 1 once the table closed, 0 if it waits for a seat
+ */
+int table_run(table_t *table);
+
+/**
+ * @brief puts a table that closed back in the free list, from the worker that ran it
+ */
+void table_pool_recycle(table_pool_t *pool, table_t *table);
+
+/**
+ * @brief whether the pool played all the tables it was asked for and none are left running
+ */
+int table_pool_done(table_pool_t *pool);
+
+/**
+ * @brief queues a packet in the inbox of the seat it came from, for the workers' reactors
+ */
+void table_queue_packet(reactor_t *reactor, int fd, const client_packet_t *pkt, void *data);
+
+/**
+ * @brief closes the inbox of a seat whose connection was closed, for the workers' reactors
+ */
+void table_queue_close(reactor_t *reactor, int fd, void *data);
+
+#endif
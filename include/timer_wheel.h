@@ -0,0 +1,87 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+// 64^4 ticks ahead at most, over 46 hours with 10 ms ticks
+#define WHEEL_LEVELS 4
+
+struct wheel_timer;
+typedef void (*wheel_timer_fn)(struct wheel_timer *timer, void *data);
+
+/**
+ * @brief a timer that lives in whatever owns it, e.g. a table, and costs no allocation to arm
+ */
+typedef struct wheel_timer {
+    uint64_t expires;               // tick it fires at
+    wheel_timer_fn fn;
+    void *data;
+    struct wheel_timer *next;
+    struct wheel_timer **pprev;     // the pointer to this timer in its slot, NULL if not armed
+} wheel_timer_t;
+
+/**
+ * @brief a hierarchical timer wheel
+ *
+ * level 0 has one slot per tick for the next 64 ticks, and every level after it one slot per 64
+ * slots of the level below. arming and cancelling a timer is O(1), and a tick only touches the
+ * timers due in it plus, once every 64 ticks, the slot of the next level that just came up,
+ * whose timers move down a level. so thousands of clocks cost no more per tick than the few
+ * that actually fire. not thread safe, its owner locks it if several threads touch it
+ */
+typedef struct {
+    int tick_ms;
+    long start_ms;                  // when tick 0 was
+    uint64_t now;                   // the last tick handled
+    int count;                      // timers armed
+    wheel_timer_t *slots[WHEEL_LEVELS][WHEEL_SLOTS];
+} timer_wheel_t;
+
+/**
+ * @brief milliseconds on the monotonic clock, the time every wheel goes by
+ */
+long timer_wheel_clock_ms(void);
+
+/**
+ * @brief sets up an empty wheel, starting now
+ *
+ * @param tick_ms how precise the timers are, they fire up to one tick late
+ */
+void timer_wheel_init(timer_wheel_t *wheel, int tick_ms, long now_ms);
+
+/**
+ * @brief arms a timer to call fn(timer, data) once delay_ms passed, re-arming it if it was armed
+ *
+ * @param now_ms the time the delay counts from, the wheel may not have been advanced to it yet
+ */
+void timer_wheel_schedule(timer_wheel_t *wheel, wheel_timer_t *timer, long now_ms, int delay_ms, wheel_timer_fn fn, void *data);
+
+/**
+ * @brief disarms a timer, does nothing if it is not armed
+ */
+void timer_wheel_cancel(timer_wheel_t *wheel, wheel_timer_t *timer);
+
+/**
+ * @brief whether a timer is armed
+ */
+int timer_wheel_pending(const wheel_timer_t *timer);
+
+/**
+ * @brief runs the wheel up to now, firing every timer that came due on the way
+ *
+ * a timer is disarmed before its function is called, which may arm it again
+ *
+ * @return the number of timers fired
+ */
+int timer_wheel_advance(timer_wheel_t *wheel, long now_ms);
+
+/**
+ * @brief how long the owner may sleep before it has to advance the wheel again
+ *
+ * @return ms until the next timer is due or the next level comes up, -1 if no timer is armed
+ */
+int timer_wheel_timeout(const timer_wheel_t *wheel, long now_ms);
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "poker_client.h"  // for client_packet_t, server_packet_t
+
+#define WIRE_RAW 0                  // the packet structs byte for byte, what every client spoke at first
+#define WIRE_COMPACT 1              // version 1 of the compact format below
+#define WIRE_DELTA 2                // version 2, the compact format with INFOs sent as what changed
+#define WIRE_SEQ 3                  // version 3, version 2 with numbered packets and responses
+#define WIRE_VERSION WIRE_SEQ       // the newest format this build speaks
+
+// room for any packet in any format, the raw END is the longest
+#define WIRE_MAX_FRAME sizeof(server_packet_t)
+
+// a raw client packet, the struct up to the seq that only the compact format carries
+#define WIRE_RAW_CLIENT offsetof(client_packet_t, seq)
+
+/**
+ * @brief the compact format, version 1
+ *
+ * every packet is a frame: the length of its body as a varint, then the body, which starts
+ * with the packet type in a byte. cards and seats take a byte each, shifted up by one so that
+ * 0 is NOCARD or nobody, chips are zigzag varints and the statuses of the six seats share
+ * two bytes, two bits each. ACK, NACK and HALT are two bytes on the wire and an INFO or an END
+ * well under 50, where every raw packet takes sizeof(server_packet_t), 132 bytes. of what a
+ * client sends only a RAISE carries its amount
+ *
+ * a connection speaks it once the ACK to a JOIN_REQUEST that asked for it (see JOIN_WIRE)
+ * agreed to it in join.wire. the JOIN and its answer are always raw
+ *
+ * version 2 sends an INFO as a delta of the last one the connection got, once it got one this
+ * hand: a type byte with the top bit set, a varint mask of the fields that changed (the hole
+ * cards, the community cards, pot, dealer, turn, bet size, stacks, bets, statuses, in that order)
+ * and their values, so an action usually costs a handful of bytes. an END ends the hand, so the
+ * first INFO of the next one goes out in full, as does the one the table answers a SNAPSHOT with
+ *
+ * version 3 puts the seq of every client packet as a varint right after its type, and the seq
+ * of the packet an ACK or NACK answers after theirs (see send_packet_async)
+ */
+
+/**
+ * @brief the last INFO a connection was sent, what the next one is a delta of
+ *
+ * the sender and the receiver both keep one per connection
+ */
+typedef struct {
+    info_packet_t info;
+    int valid;          // there is an INFO this hand to send a delta of
+} wire_base_t;
+
+/**
+ * @brief encodes a packet of the server for the wire
+ *
+ * @param base the connection's last INFO, kept up to date. may be NULL before version 2
+ * @param buf room for WIRE_MAX_FRAME bytes
+ * @return the number of bytes written
+ */
+size_t wire_encode_server(int version, const server_packet_t *pkt, wire_base_t *base, uint8_t *buf);
+
+/**
+ * @brief decodes the first packet of the server in the bytes received so far
+ *
+ * an INFO always comes out whole, with a delta applied to the connection's last one
+ *
+ * @param base the connection's last INFO, kept up to date. may be NULL before version 2
+ * @param used set to the number of bytes the packet took on a success
+ * @return 1 if a whole packet was decoded, 0 if more bytes are needed, -1 if the bytes are no packet
+ */
+int wire_decode_server(int version, const uint8_t *buf, size_t len, wire_base_t *base, server_packet_t *pkt, size_t *used);
+
+/**
+ * @brief encodes a packet of a client for the wire
+ *
+ * @param buf room for WIRE_MAX_FRAME bytes
+ * @return the number of bytes written
+ */
+size_t wire_encode_client(int version, const client_packet_t *pkt, uint8_t *buf);
+
+/**
+ * @brief decodes the first packet of a client in the bytes received so far
+ *
+ * a compact client packet is never longer than a client_packet_t
+ *
+ * @param used set to the number of bytes the packet took on a success
+ * @return 1 if a whole packet was decoded, 0 if more bytes are needed, -1 if the bytes are no packet
+ */
+int wire_decode_client(int version, const uint8_t *buf, size_t len, client_packet_t *pkt, size_t *used);
+
+#endif
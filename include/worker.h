@@ -0,0 +1,87 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <pthread.h>
+#include "reactor.h"      // for reactor_t
+#include "timer_wheel.h"  // for timer_wheel_t
+
+struct table;
+struct table_pool;
+
+// A connection an acceptor sat down at a table, waiting for the table's worker to watch it
+typedef struct hand_off {
+    struct table *table;
+    int fd;
+    int wire;                       // the wire format of the player's packets, see wire.h
+    struct hand_off *next;
+} hand_off_t;
+
+/**
+ * @brief one thread of the server, pinned to a core
+ *
+ * a worker owns a shard of the tables: their sockets are in its reactor, their turn clocks on its
+ * timer wheel, and the tables go on its run queue whenever a packet they wait for arrives or a
+ * clock runs out. a worker that runs out of tables to run takes them from the run queues
+ * of the others, so a table can be played on any thread, but only ever on one at a time
+ */
+typedef struct worker {
+    int id;
+    pthread_t thread;
+    reactor_t *reactor;             // the sockets of every table the worker owns
+    struct table_pool *pool;
+
+    pthread_mutex_t lock;           // guards the run queue and the hand offs
+    struct table *run_head;         // tables that can run, oldest first
+    struct table *run_tail;
+    int run_length;
+    hand_off_t *hand_offs;
+    int idle;                       // waiting in its reactor with nothing to run
+
+    pthread_mutex_t timer_lock;     // guards the wheel, armed from whichever worker runs the table
+    timer_wheel_t timers;           // the turn clocks of the tables the worker owns
+
+    int stop;
+} worker_t;
+
+/**
+ * @brief starts the workers of a pool, one per core unless asked for a number
+ *
+ * @param num_workers threads to start, 0 for one per online core
+ * @return 0 on success, -1 on failure
+ */
+int workers_start(struct table_pool *pool, int num_workers);
+
+/**
+ * @brief stops every worker of a pool once it is done, and waits for them
+ */
+void workers_stop(struct table_pool *pool);
+
+/**
+ * @brief hands a connection to the worker that owns its table, which starts watching it
+ *
+ * @param wire the wire format the connection's packets come in, see wire.h
+ *
+ * safe to call from any thread
+ */
+void worker_hand_off(worker_t *worker, struct table *table, int fd, int wire);
+
+/**
+ * @brief arms a timer on a worker's wheel, fn then runs on the worker's thread
+ *
+ * safe to call from any thread, fn must not arm or cancel timers of the same worker
+ */
+void worker_arm_timer(worker_t *worker, wheel_timer_t *timer, int delay_ms, wheel_timer_fn fn, void *data);
+
+/**
+ * @brief disarms a timer of a worker's wheel, once this returns its function is not running
+ */
+void worker_cancel_timer(worker_t *worker, wheel_timer_t *timer);
+
+/**
+ * @brief puts a table on its owner's run queue, with the table's lock held
+ *
+ * a table that is running already runs again as soon as it waits
+ */
+void worker_wake_table(struct table *table);
+
+#endif
@@ -0,0 +1,109 @@
+/**
+ * Checks and times equity_calculate on a few classic all-in spots.
+ *
+ * every spot is enumerated exactly, then sampled on one thread and on all threads. the two
+ * sampled runs must agree to the last bit (same seed, same boards) and land close to the exact
+ * equity, the benchmark exits with 1 if either is off
+ *
+ * usage: ./build/bench.equity_bench [iterations] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "equity.h"
+
+typedef struct {
+    const char *name;
+    int num_players;
+    card_t hole_cards[MAX_PLAYERS][HAND_SIZE];
+    int num_board;
+    card_t board[MAX_COMMUNITY_CARDS];
+} spot_t;
+
+static const spot_t spots[] = {
+    {"AA vs KK preflop", 2, {{ACE OF SPADE, ACE OF HEART}, {KING OF SPADE, KING OF HEART}}, 0, {0}},
+    {"AKs vs QQ preflop", 2, {{ACE OF SPADE, KING OF SPADE}, {QUEEN OF HEART, QUEEN OF CLUB}}, 0, {0}},
+    {"3 way preflop", 3, {{ACE OF SPADE, ACE OF HEART}, {KING OF CLUB, QUEEN OF CLUB}, {SEVEN OF DIAMOND, TWO OF HEART}}, 0, {0}},
+    {"6 way preflop", 6, {{ACE OF SPADE, ACE OF HEART}, {KING OF CLUB, KING OF DIAMOND}, {QUEEN OF SPADE, JACK OF SPADE},
+                         {TEN OF HEART, TEN OF CLUB}, {NINE OF DIAMOND, EIGHT OF DIAMOND}, {FIVE OF CLUB, FOUR OF CLUB}}, 0, {0}},
+    {"set vs flush draw on the flop", 2, {{SEVEN OF CLUB, SEVEN OF DIAMOND}, {ACE OF HEART, KING OF HEART}}, 3,
+                                         {SEVEN OF HEART, TWO OF HEART, JACK OF SPADE}},
+    {"chopped on the turn", 2, {{ACE OF CLUB, TWO OF DIAMOND}, {ACE OF DIAMOND, THREE OF CLUB}}, 4,
+                               {KING OF SPADE, QUEEN OF SPADE, JACK OF HEART, TEN OF CLUB}},
+};
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void print_result(const spot_t *spot, const char *how, const equity_result_t *result, double seconds) {
+    printf("  %-20s %9ld boards %8.1f ms %7.1f Mboards/s  ", how, result->boards, seconds * 1e3,
+           result->boards / seconds / 1e6);
+    for (int i = 0; i < spot->num_players; i++) printf(" %6.2f%%", 100 * result->equity[i]);
+    printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    uint64_t seed = argc > 2 ? strtoull(argv[2], NULL, 0) : 1;
+    int num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int failed = 0;
+
+    for (size_t s = 0; s < sizeof(spots) / sizeof(spots[0]); s++) {
+        const spot_t *spot = &spots[s];
+        printf("%s\n", spot->name);
+
+        equity_request_t request;
+        memset(&request, 0, sizeof(request));
+        request.num_players = spot->num_players;
+        memcpy(request.hole_cards, spot->hole_cards, sizeof(request.hole_cards));
+        memcpy(request.board, spot->board, sizeof(request.board));
+        request.num_board = spot->num_board;
+        request.seed = seed;
+
+        // enumerate no matter how many boards there are
+        equity_result_t exact;
+        request.exact_limit = 1L << 40;
+        double start = now_sec();
+        equity_calculate(&request, &exact);
+        print_result(spot, "exact", &exact, now_sec() - start);
+
+        equity_result_t single;
+        equity_result_t all;
+        request.exact_limit = 1;
+        request.iterations = iterations;
+        request.num_threads = 1;
+        start = now_sec();
+        equity_calculate(&request, &single);
+        print_result(spot, "sampled, 1 thread", &single, now_sec() - start);
+
+        char how[32];
+        snprintf(how, sizeof(how), "sampled, %d threads", num_threads);
+        request.num_threads = num_threads;
+        start = now_sec();
+        equity_calculate(&request, &all);
+        print_result(spot, how, &all, now_sec() - start);
+
+        if (memcmp(&single, &all, sizeof(single)) != 0) {
+            fprintf(stderr, "  sampled results depend on the number of threads\n");
+            failed = 1;
+        }
+        for (int i = 0; i < spot->num_players; i++) {
+            // five standard errors of a share of the pot, generous enough never to trip by chance
+            double diff = single.equity[i] - exact.equity[i];
+            double variance = exact.equity[i] * (1 - exact.equity[i]) / iterations;
+            if (diff * diff > 25 * variance + 1e-12) {
+                fprintf(stderr, "  player %d sampled %.4f but exact is %.4f\n", i, single.equity[i], exact.equity[i]);
+                failed = 1;
+            }
+        }
+    }
+
+    return failed;
+}
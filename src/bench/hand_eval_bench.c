@@ -0,0 +1,163 @@
+/**
+ * Benchmarks the showdown evaluators against each other.
+ *
+ *  showdown: many random boards with MAX_PLAYERS hole pairs each, the shape find_winner sees
+ *  bulk:     one board with thousands of hole pairs, the shape equity tools and simulators see
+ *
+ * every path must produce the same scores, the benchmark exits with 1 if any of them disagree
+ *
+ * usage: ./build/bench.hand_eval_bench [num_boards] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "game_logic.h"
+#include "hand_eval.h"
+
+#define BULK_HANDS 4096
+#define BULK_ROUNDS 200
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Deals the board and num_hands hole pairs out of one shuffled deck
+static void deal(card_t board[HAND_EVAL_BOARD_CARDS], card_t hole_cards[][2], int num_hands) {
+    card_t deck[DECK_SIZE];
+    for (int i = 0; i < DECK_SIZE; i++) deck[i] = i;
+    for (int i = DECK_SIZE - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        card_t temp = deck[i];
+        deck[i] = deck[j];
+        deck[j] = temp;
+    }
+
+    int next = 0;
+    for (int i = 0; i < HAND_EVAL_BOARD_CARDS; i++) board[i] = deck[next++];
+    for (int i = 0; i < num_hands; i++) {
+        // bulk batches need more pairs than a deck holds, reuse cards that are not on the board
+        if (next + 2 > DECK_SIZE) next = HAND_EVAL_BOARD_CARDS;
+        hole_cards[i][0] = deck[next++];
+        hole_cards[i][1] = deck[next++];
+    }
+}
+
+static void report(const char *scenario, const char *path, long hands, double seconds) {
+    printf("%-9s %-18s %12.1f Mhands/s %8.2f ns/hand\n", scenario, path, hands / seconds / 1e6, seconds * 1e9 / hands);
+}
+
+static int verify_scores(const char *path, const int *expected, const int *actual, long n) {
+    for (long i = 0; i < n; i++) {
+        if (expected[i] != actual[i]) {
+            fprintf(stderr, "%s disagrees with hand_eval7 on hand %ld (%x vs %x)\n", path, i, actual[i], expected[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int num_boards = argc > 1 ? atoi(argv[1]) : 200000;
+    int seed = argc > 2 ? atoi(argv[2]) : 1;
+    int failed = 0;
+
+    srand(seed);
+    hand_eval_init();
+    printf("best kernel: %s\n", hand_eval_kernel_name(hand_eval_best_kernel()));
+    printf("tables: %s\n", hand_eval_tables_loaded() ? "mapped" : "missing, run make tables");
+
+    // ---------------------------- showdown sized batches ---------------------------- //
+
+    long num_hands = (long)num_boards * MAX_PLAYERS;
+    card_t (*boards)[HAND_EVAL_BOARD_CARDS] = malloc(num_boards * sizeof(*boards));
+    card_t (*hole_cards)[2] = malloc(num_hands * sizeof(*hole_cards));
+    int *expected = malloc(num_hands * sizeof(int));
+    int *scores = malloc(num_hands * sizeof(int));
+
+    for (int b = 0; b < num_boards; b++) {
+        deal(boards[b], hole_cards + (long)b * MAX_PLAYERS, MAX_PLAYERS);
+    }
+
+    // the 21 combination reference is slow, only time a slice of it
+    int reference_boards = num_boards < 20000 ? num_boards : 20000;
+    double start = now_sec();
+    for (int b = 0; b < reference_boards; b++) {
+        for (int p = 0; p < MAX_PLAYERS; p++) {
+            card_t cards[HAND_EVAL_CARDS];
+            memcpy(cards, boards[b], sizeof(boards[b]));
+            cards[5] = hole_cards[b * MAX_PLAYERS + p][0];
+            cards[6] = hole_cards[b * MAX_PLAYERS + p][1];
+            scores[b * MAX_PLAYERS + p] = evaluate_hand_combinations(cards);
+        }
+    }
+    report("showdown", "combinations", (long)reference_boards * MAX_PLAYERS, now_sec() - start);
+
+    start = now_sec();
+    for (int b = 0; b < num_boards; b++) {
+        for (int p = 0; p < MAX_PLAYERS; p++) {
+            card_t cards[HAND_EVAL_CARDS];
+            memcpy(cards, boards[b], sizeof(boards[b]));
+            cards[5] = hole_cards[b * MAX_PLAYERS + p][0];
+            cards[6] = hole_cards[b * MAX_PLAYERS + p][1];
+            expected[b * MAX_PLAYERS + p] = hand_eval7(cards);
+        }
+    }
+    report("showdown", "hand_eval7", num_hands, now_sec() - start);
+    failed |= verify_scores("combinations", expected, scores, (long)reference_boards * MAX_PLAYERS);
+
+    for (hand_eval_kernel_t kernel = HAND_EVAL_KERNEL_SCALAR; kernel <= hand_eval_best_kernel(); kernel++) {
+        char path[32];
+        snprintf(path, sizeof(path), "batch %s", hand_eval_kernel_name(kernel));
+
+        memset(scores, 0, num_hands * sizeof(int));
+        start = now_sec();
+        for (int b = 0; b < num_boards; b++) {
+            hand_eval_batch_kernel(kernel, boards[b], hole_cards + (long)b * MAX_PLAYERS, MAX_PLAYERS,
+                                   scores + (long)b * MAX_PLAYERS);
+        }
+        report("showdown", path, num_hands, now_sec() - start);
+        failed |= verify_scores(path, expected, scores, num_hands);
+    }
+
+    // ---------------------------- bulk batches ---------------------------- //
+
+    card_t board[HAND_EVAL_BOARD_CARDS];
+    card_t (*bulk)[2] = malloc(BULK_HANDS * sizeof(*bulk));
+    int bulk_expected[BULK_HANDS];
+    int bulk_scores[BULK_HANDS];
+    deal(board, bulk, BULK_HANDS);
+
+    start = now_sec();
+    for (int round = 0; round < BULK_ROUNDS; round++) {
+        for (int i = 0; i < BULK_HANDS; i++) {
+            card_t cards[HAND_EVAL_CARDS] = {board[0], board[1], board[2], board[3], board[4], bulk[i][0], bulk[i][1]};
+            bulk_expected[i] = hand_eval7(cards);
+        }
+    }
+    report("bulk", "hand_eval7", (long)BULK_ROUNDS * BULK_HANDS, now_sec() - start);
+
+    for (hand_eval_kernel_t kernel = HAND_EVAL_KERNEL_SCALAR; kernel <= hand_eval_best_kernel(); kernel++) {
+        char path[32];
+        snprintf(path, sizeof(path), "batch %s", hand_eval_kernel_name(kernel));
+
+        start = now_sec();
+        for (int round = 0; round < BULK_ROUNDS; round++) {
+            hand_eval_batch_kernel(kernel, board, bulk, BULK_HANDS, bulk_scores);
+        }
+        report("bulk", path, (long)BULK_ROUNDS * BULK_HANDS, now_sec() - start);
+        failed |= verify_scores(path, bulk_expected, bulk_scores, BULK_HANDS);
+    }
+
+    free(bulk);
+    free(scores);
+    free(expected);
+    free(hole_cards);
+    free(boards);
+
+    return failed;
+}
@@ -0,0 +1,300 @@
+/**
+ * Runs every hand evaluator over every possible hand, the gate for swapping evaluators in production.
+ *
+ *  five cards:  all 2,598,960 hands, calculate_5card_value against hand_eval_card_set
+ *  seven cards: all 133,784,560 hands, evaluate_hand_combinations against hand_eval7,
+ *               hand_eval_card_set and every batch kernel the cpu supports
+ *
+ * for both sizes it prints how many hands fall in every class (checked against the known counts),
+ * how many hands each evaluator scores differently from the reference, and the hands/s of every
+ * evaluator on one thread and on all threads. exits with 1 if anything is off.
+ *
+ * usage: ./build/bench.hand_eval_exhaustive [threads]
+ *
+ * threads defaults to the number of online cores
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "game_logic.h"
+#include "hand_eval.h"
+
+#define NUM_CLASSES 10  // [HAND_RANK]20 goes from 1 (high card) to 9 (straight flush)
+#define MAX_HOLE_PAIRS ((DECK_SIZE - HAND_EVAL_BOARD_CARDS) * (DECK_SIZE - HAND_EVAL_BOARD_CARDS - 1) / 2)
+
+static const char *class_names[NUM_CLASSES] = {
+    "", "high card", "one pair", "two pair", "three of a kind", "straight",
+    "flush", "full house", "four of a kind", "straight flush"
+};
+
+// how many hands of each class there are, from any poker probability table
+static const long five_card_classes[NUM_CLASSES] = {
+    0, 1302540, 1098240, 123552, 54912, 10200, 5108, 3744, 624, 40
+};
+static const long seven_card_classes[NUM_CLASSES] = {
+    0, 23294460, 58627800, 31433400, 6461620, 6180020, 4047644, 3473184, 224848, 41584
+};
+
+typedef enum {
+    EVAL_REFERENCE = 0,     // calculate_5card_value, over all 21 combinations for seven cards
+    EVAL_HAND_EVAL7,        // seven cards only
+    EVAL_CARD_SET,
+    EVAL_BATCH_SCALAR,      // EVAL_BATCH_SCALAR + kernel for every hand_eval_kernel_t, seven cards only
+    EVAL_BATCH_SSE4,
+    EVAL_BATCH_AVX2,
+    NUM_EVALUATORS
+} evaluator_t;
+
+static const char *evaluator_names[NUM_EVALUATORS] = {
+    "reference", "hand_eval7", "card_set", "batch scalar", "batch sse4.1", "batch avx2"
+};
+
+// What one thread does with the units it takes, and what it found
+typedef struct {
+    int verify;                         // score with every evaluator and compare, or time just one
+    evaluator_t evaluator;              // the evaluator to time when not verifying
+    long hands;
+    long classes[NUM_CLASSES];
+    long mismatches[NUM_EVALUATORS];
+    long checksum;                      // sum of every score, keeps the timed work from being optimized away
+} job_t;
+
+typedef struct {
+    void (*unit)(int unit, job_t *job);
+    int num_units;
+    int next_unit;                      // handed out with an atomic add, so busy threads take fewer units
+    job_t job;
+} pool_t;
+
+static evaluator_t last_evaluator = EVAL_CARD_SET;
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// ---------------------------- five cards ---------------------------- //
+
+static int score_five(evaluator_t evaluator, card_t a, card_t b, card_t c, card_t d, card_t e) {
+    if (evaluator == EVAL_CARD_SET) {
+        return hand_eval_card_set(card_set_of(a) | card_set_of(b) | card_set_of(c) | card_set_of(d) | card_set_of(e));
+    }
+    // calculate_5card_value wants the cards highest rank first, a < b < c < d < e already sorts them by rank
+    card_t hand[5] = {e, d, c, b, a};
+    return calculate_5card_value(hand);
+}
+
+// One unit is every hand whose lowest card is unit
+static void five_card_unit(int unit, job_t *job) {
+    card_t a = unit;
+    for (card_t b = a + 1; b < DECK_SIZE; b++) {
+        for (card_t c = b + 1; c < DECK_SIZE; c++) {
+            for (card_t d = c + 1; d < DECK_SIZE; d++) {
+                for (card_t e = d + 1; e < DECK_SIZE; e++) {
+                    job->hands++;
+                    if (!job->verify) {
+                        job->checksum += score_five(job->evaluator, a, b, c, d, e);
+                        continue;
+                    }
+
+                    int expected = score_five(EVAL_REFERENCE, a, b, c, d, e);
+                    job->classes[expected >> 20]++;
+                    job->checksum += expected;
+                    if (score_five(EVAL_CARD_SET, a, b, c, d, e) != expected) job->mismatches[EVAL_CARD_SET]++;
+                }
+            }
+        }
+    }
+}
+
+// ---------------------------- seven cards ---------------------------- //
+
+// Scores the board with every pair of hole cards
+static void score_seven(evaluator_t evaluator, const card_t board[HAND_EVAL_BOARD_CARDS],
+                        const card_t hole_cards[][2], int num_hands, int scores[]) {
+    if (evaluator >= EVAL_BATCH_SCALAR) {
+        hand_eval_batch_kernel(evaluator - EVAL_BATCH_SCALAR, board, hole_cards, num_hands, scores);
+        return;
+    }
+
+    for (int i = 0; i < num_hands; i++) {
+        card_t cards[HAND_EVAL_CARDS] = {board[0], board[1], board[2], board[3], board[4], hole_cards[i][0], hole_cards[i][1]};
+        switch (evaluator) {
+            case EVAL_HAND_EVAL7:
+                scores[i] = hand_eval7(cards);
+                break;
+            case EVAL_CARD_SET:
+                scores[i] = hand_eval_card_set(card_set_from_cards(cards, HAND_EVAL_CARDS));
+                break;
+            default:
+                scores[i] = evaluate_hand_combinations(cards);
+                break;
+        }
+    }
+}
+
+// One unit is every hand whose two lowest cards are the unit-th pair. the five lowest cards make
+// the board and the two highest the hole cards, so every board is scored as one batch
+static void seven_card_unit(int unit, job_t *job) {
+    card_t a = unit / DECK_SIZE;
+    card_t b = unit % DECK_SIZE;
+    if (b <= a) return;
+
+    card_t hole_cards[MAX_HOLE_PAIRS][2];
+    int expected[MAX_HOLE_PAIRS];
+    int scores[MAX_HOLE_PAIRS];
+
+    for (card_t c = b + 1; c < DECK_SIZE; c++) {
+        for (card_t d = c + 1; d < DECK_SIZE; d++) {
+            for (card_t e = d + 1; e < DECK_SIZE; e++) {
+                card_t board[HAND_EVAL_BOARD_CARDS] = {a, b, c, d, e};
+                int num_hands = 0;
+                for (card_t f = e + 1; f < DECK_SIZE; f++) {
+                    for (card_t g = f + 1; g < DECK_SIZE; g++) {
+                        hole_cards[num_hands][0] = f;
+                        hole_cards[num_hands][1] = g;
+                        num_hands++;
+                    }
+                }
+                if (num_hands == 0) continue;
+                job->hands += num_hands;
+
+                if (!job->verify) {
+                    score_seven(job->evaluator, board, hole_cards, num_hands, scores);
+                    for (int i = 0; i < num_hands; i++) job->checksum += scores[i];
+                    continue;
+                }
+
+                score_seven(EVAL_REFERENCE, board, hole_cards, num_hands, expected);
+                for (int i = 0; i < num_hands; i++) {
+                    job->classes[expected[i] >> 20]++;
+                    job->checksum += expected[i];
+                }
+
+                for (evaluator_t evaluator = EVAL_HAND_EVAL7; evaluator <= last_evaluator; evaluator++) {
+                    score_seven(evaluator, board, hole_cards, num_hands, scores);
+                    for (int i = 0; i < num_hands; i++) {
+                        if (scores[i] != expected[i]) job->mismatches[evaluator]++;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// ---------------------------- thread pool ---------------------------- //
+
+static void *pool_thread(void *arg) {
+    pool_t *pool = arg;
+    job_t *job = malloc(sizeof(job_t));
+    *job = pool->job;
+
+    int unit;
+    while ((unit = __atomic_fetch_add(&pool->next_unit, 1, __ATOMIC_RELAXED)) < pool->num_units) {
+        pool->unit(unit, job);
+    }
+    return job;
+}
+
+// Runs every unit on num_threads threads and sums up what they found
+static job_t run_units(void (*unit)(int, job_t *), int num_units, int num_threads, job_t job, double *seconds) {
+    pool_t pool = {unit, num_units, 0, job};
+    pthread_t threads[num_threads];
+    job_t total = job;
+
+    double start = now_sec();
+    for (int t = 0; t < num_threads; t++) pthread_create(&threads[t], NULL, pool_thread, &pool);
+    for (int t = 0; t < num_threads; t++) {
+        job_t *result;
+        pthread_join(threads[t], (void **)&result);
+        total.hands += result->hands;
+        total.checksum += result->checksum;
+        for (int i = 0; i < NUM_CLASSES; i++) total.classes[i] += result->classes[i];
+        for (int i = 0; i < NUM_EVALUATORS; i++) total.mismatches[i] += result->mismatches[i];
+        free(result);
+    }
+    *seconds = now_sec() - start;
+    return total;
+}
+
+// ---------------------------- reports ---------------------------- //
+
+// Verifies every hand of one size, then times every evaluator on it. returns 1 on any failure
+static int run_size(const char *size, void (*unit)(int, job_t *), int num_units, const long *known_classes,
+                    const evaluator_t *evaluators, int num_evaluators, int num_threads) {
+    int failed = 0;
+    double seconds;
+
+    printf("\n%s: verifying on %d threads\n", size, num_threads);
+    job_t verify = {.verify = 1};
+    verify = run_units(unit, num_units, num_threads, verify, &seconds);
+
+    long known_total = 0;
+    for (int i = 1; i < NUM_CLASSES; i++) {
+        known_total += known_classes[i];
+        int ok = verify.classes[i] == known_classes[i];
+        printf("  %-16s %10ld %s\n", class_names[i], verify.classes[i], ok ? "" : "expected a different count");
+        failed |= !ok;
+    }
+    printf("  %-16s %10ld %s\n", "total", verify.hands, verify.hands == known_total ? "" : "expected a different count");
+    failed |= verify.hands != known_total;
+
+    for (int e = 1; e < num_evaluators; e++) {
+        evaluator_t evaluator = evaluators[e];
+        printf("  %-16s %10ld mismatches\n", evaluator_names[evaluator], verify.mismatches[evaluator]);
+        failed |= verify.mismatches[evaluator] != 0;
+    }
+
+    printf("%s: throughput\n", size);
+    for (int e = 0; e < num_evaluators; e++) {
+        evaluator_t evaluator = evaluators[e];
+        job_t timed = {.verify = 0, .evaluator = evaluator};
+        job_t single = run_units(unit, num_units, 1, timed, &seconds);
+        printf("  %-16s %10.1f Mhands/s on 1 thread", evaluator_names[evaluator], single.hands / seconds / 1e6);
+
+        // a different sum means some evaluator scored a hand differently only when timed
+        failed |= single.checksum != verify.checksum;
+
+        if (num_threads > 1) {
+            job_t all = run_units(unit, num_units, num_threads, timed, &seconds);
+            printf(", %10.1f Mhands/s on %d threads", all.hands / seconds / 1e6, num_threads);
+            failed |= all.checksum != verify.checksum;
+        }
+        printf("\n");
+    }
+
+    return failed;
+}
+
+int main(int argc, char *argv[]) {
+    int num_threads = argc > 1 ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads < 1) num_threads = 1;
+
+    hand_eval_init();
+    last_evaluator = EVAL_BATCH_SCALAR + hand_eval_best_kernel();
+    printf("best kernel: %s\n", hand_eval_kernel_name(hand_eval_best_kernel()));
+    printf("tables: %s\n", hand_eval_tables_loaded() ? "mapped" : "missing, run make tables");
+
+    // the reference goes first in both lists, the others are checked against it
+    evaluator_t five_card_evaluators[] = {EVAL_REFERENCE, EVAL_CARD_SET};
+    evaluator_t seven_card_evaluators[NUM_EVALUATORS];
+    int num_seven_card_evaluators = 0;
+    for (evaluator_t evaluator = EVAL_REFERENCE; evaluator <= last_evaluator; evaluator++) {
+        seven_card_evaluators[num_seven_card_evaluators++] = evaluator;
+    }
+
+    int failed = 0;
+    failed |= run_size("five cards", five_card_unit, DECK_SIZE, five_card_classes,
+                       five_card_evaluators, 2, num_threads);
+    failed |= run_size("seven cards", seven_card_unit, DECK_SIZE * DECK_SIZE, seven_card_classes,
+                       seven_card_evaluators, num_seven_card_evaluators, num_threads);
+
+    printf("\n%s\n", failed ? "FAILED" : "every evaluator agrees on every hand");
+    return failed;
+}
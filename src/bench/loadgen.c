@@ -0,0 +1,408 @@
+/**
+ * Loads a real server over loopback and measures how many hands and actions it plays per second.
+ *
+ * starts ./build/server.poker_server as a child, seats the given number of simulated players at
+ * the given number of tables through the client library, and plays every seat for some hands with
+ * one of the strategies below, all of them over connections of their own
+ *
+ *  check:       checks when nobody bet, calls otherwise
+ *  random:      folds, raises or checks and calls at random, so hands end at every street
+ *  aggressive:  raises a quarter of the pot whenever the stack allows it, which makes betting rounds longest
+ *
+ * the seats are spread over client threads, every thread runs one poll() loop over its
+ * connections and acts from the handlers with send_packet_async, so one thread keeps hundreds of
+ * seats playing. an action the server NACKs falls back to checking or calling, then to folding.
+ *
+ * it reports hands and actions per second and the percentiles of the time from sending an action
+ * to the next INFO or END on that connection, which is the server's turnaround as a player sees
+ * it. the CPU time the server process and this one used in that window comes from /proc and
+ * getrusage: on a machine with fewer cores than server workers plus client threads the two fight
+ * over them, which the numbers make visible. whatever comes after the strategy is handed to the
+ * server, e.g. -w 4 -b io_uring. exits with 1 if a seat could not join or the tables stalled
+ *
+ * usage: ./build/bench.loadgen [seats] [tables] [hands] [check|random|aggressive] [threads] [server flags...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "poker_client.h"
+#include "rng.h"
+
+#define MAX_ARGS 32
+#define JOIN_DEADLINE_MS "50"   // how long a table of fewer than six waits for its players
+#define STALL_MS 10000          // a poll without a single packet for this long means the tables are stuck
+#define CONNECT_TRIES 250       // 5 seconds for the server to start listening
+
+typedef enum {
+    STRATEGY_CHECK,
+    STRATEGY_RANDOM,
+    STRATEGY_AGGRESSIVE
+} strategy_t;
+
+static const char *STRATEGY_NAMES[] = { "check", "random", "aggressive" };
+
+typedef struct worker worker_t;
+
+// One simulated player
+typedef struct {
+    poker_conn_t *conn;
+    worker_t *worker;
+    int table;
+    player_id_t seat;
+    info_packet_t info;         // the last INFO, what an action that was NACKed falls back on
+    client_packet_type_t last;  // the last action sent
+    int hands;                  // ENDs seen
+    double acted_at;            // when the action the next INFO answers was sent, 0 if none is outstanding
+    int busted;
+    int closed;
+} seat_t;
+
+// One client thread and the seats it plays
+struct worker {
+    seat_t *seats;
+    int num_seats;
+    rng_t rng;
+    double *latencies;          // seconds from an action to the INFO or END after it
+    size_t num_latencies;
+    size_t cap_latencies;
+    long actions;
+    long nacks;
+    int stalled;
+    pthread_t thread;
+};
+
+static strategy_t strategy = STRATEGY_CHECK;
+static int hands_per_seat = 20;
+
+static double now_sec(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// ---------------------------- playing ---------------------------- //
+
+static void on_reply(unsigned seq, int acked, void *data);
+
+static void act(seat_t *me, client_packet_type_t type, int amount) {
+    client_packet_t pkt = { .packet_type = type };
+    pkt.params[0] = amount;
+    me->last = type;
+    me->acted_at = now_sec(CLOCK_MONOTONIC);
+    poker_send_packet_async(me->conn, &pkt, on_reply, me);
+}
+
+// the server has no all-in for less, a player who cannot cover the bet has to fold
+static void check_or_call(seat_t *me) {
+    int to_call = me->info.bet_size - me->info.player_bets[me->seat];
+    if (to_call > me->info.player_stacks[me->seat]) act(me, FOLD, 0);
+    else act(me, me->info.bet_size == 0 ? CHECK : CALL, 0);
+}
+
+// the first action of a turn. RAISE adds its amount to what the player bet this round, which has
+// to end up above the bet to call
+static void choose_action(seat_t *me) {
+    info_packet_t *info = &me->info;
+    int to_call = info->bet_size - info->player_bets[me->seat];
+    int stack = info->player_stacks[me->seat];
+    int amount = 0;
+    if (strategy == STRATEGY_AGGRESSIVE) {
+        amount = to_call + (info->pot_size / 4 > 0 ? info->pot_size / 4 : 1);
+    } else if (strategy == STRATEGY_RANDOM) {
+        uint32_t roll = rng_bounded(&me->worker->rng, 10);
+        if (roll == 0 && to_call > 0) {
+            act(me, FOLD, 0);
+            return;
+        }
+        if (roll < 3 && stack > to_call) amount = to_call + 1 + rng_bounded(&me->worker->rng, (stack - to_call + 3) / 4);
+    }
+    if (amount > 0 && amount <= stack) act(me, RAISE, amount);
+    else check_or_call(me);
+}
+
+static void on_reply(unsigned seq, int acked, void *data) {
+    seat_t *me = data;
+    if (acked) {
+        me->worker->actions++;
+        return;
+    }
+    // the server waits for the same player to act again, without another INFO
+    me->worker->nacks++;
+    if (me->last == RAISE) check_or_call(me);
+    else if (me->last == CHECK) act(me, CALL, 0);
+    else if (me->last == CALL) act(me, FOLD, 0);
+    else me->acted_at = 0; // even a FOLD was refused, so it was not this player's turn after all
+}
+
+static void record_latency(seat_t *me) {
+    worker_t *w = me->worker;
+    if (me->acted_at == 0) return;
+    if (w->num_latencies == w->cap_latencies) {
+        w->cap_latencies = w->cap_latencies ? w->cap_latencies * 2 : 4096;
+        w->latencies = realloc(w->latencies, w->cap_latencies * sizeof(double));
+    }
+    w->latencies[w->num_latencies++] = now_sec(CLOCK_MONOTONIC) - me->acted_at;
+    me->acted_at = 0;
+}
+
+static void on_info(poker_conn_t *conn, info_packet_t *info) {
+    seat_t *me = poker_conn_data(conn);
+    record_latency(me);
+    me->info = *info;
+    if (info->player_turn == me->seat) choose_action(me);
+}
+
+static void on_end(poker_conn_t *conn, end_packet_t *end) {
+    seat_t *me = poker_conn_data(conn);
+    record_latency(me);
+    me->hands++;
+    // a player without chips would be NACKed and thrown out on their READY
+    me->busted = end->player_stacks[me->seat] <= 0;
+    client_packet_t next = { .packet_type = me->hands < hands_per_seat && !me->busted ? READY : LEAVE };
+    poker_send_packet_async(conn, &next, NULL, NULL);
+}
+
+// Runs the poll() loop of one client thread until the server closed all of its connections
+static void *run_worker(void *arg) {
+    worker_t *w = arg;
+    struct pollfd *fds = malloc(w->num_seats * sizeof(struct pollfd));
+    for (int i = 0; i < w->num_seats; i++) {
+        fds[i] = (struct pollfd){ .fd = poker_client_fd(w->seats[i].conn), .events = POLLIN };
+    }
+    int open = w->num_seats;
+    while (open > 0) {
+        if (poll(fds, w->num_seats, STALL_MS) <= 0) {
+            w->stalled = open;
+            break;
+        }
+        for (int i = 0; i < w->num_seats; i++) {
+            if (fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            if (poker_poll_packets(w->seats[i].conn) < 0) {
+                w->seats[i].closed = 1;
+                fds[i].fd = -1;
+                open--;
+            }
+        }
+    }
+    free(fds);
+    return NULL;
+}
+
+// ---------------------------- the server ---------------------------- //
+
+// Starts the server next to this binary, its output goes to /dev/null
+static pid_t start_server(const char *self, int tables, int min_seats, char **flags, int num_flags) {
+    static char path[256], tables_arg[16];
+    const char *slash = strrchr(self, '/');
+    snprintf(path, sizeof(path), "%.*sserver.poker_server", slash ? (int)(slash - self + 1) : 0, self);
+    snprintf(tables_arg, sizeof(tables_arg), "%d", tables);
+
+    char *args[MAX_ARGS];
+    int n = 0;
+    args[n++] = path;
+    args[n++] = "-t";
+    args[n++] = tables_arg;
+    args[n++] = "-n";
+    if (min_seats < MAX_PLAYERS) { // tables that never fill up start on their deadline
+        args[n++] = "-d";
+        args[n++] = JOIN_DEADLINE_MS;
+    }
+    for (int i = 0; i < num_flags && n < MAX_ARGS - 1; i++) args[n++] = flags[i];
+    args[n] = NULL;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) dup2(null_fd, STDOUT_FILENO);
+        execv(path, args);
+        perror(path);
+        _exit(127);
+    }
+    return pid;
+}
+
+// CPU time the process used so far, user and system, from /proc/<pid>/stat
+static double process_cpu_sec(pid_t pid) {
+    char path[64], buf[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return 0;
+    size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[len] = '\0';
+    // the name in parentheses may hold spaces, the fields after it are state, 5 ids, flags, 4 fault counts, utime and stime
+    char *fields = strrchr(buf, ')');
+    unsigned long utime, stime;
+    if (fields == NULL || sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2) return 0;
+    return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+static double self_cpu_sec(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+// Gives the server a few seconds to finish its last tables and exit on its own
+static void stop_server(pid_t pid) {
+    struct timespec tick = { 0, 20000000 };
+    for (int i = 0; i < CONNECT_TRIES; i++) {
+        if (waitpid(pid, NULL, WNOHANG) == pid) return;
+        nanosleep(&tick, NULL);
+    }
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+// Seats a player, retrying while the server is still starting up
+static int join(seat_t *seat, pid_t server, int retry) {
+    struct timespec tick = { 0, 20000000 };
+    for (int i = 0; i < (retry ? CONNECT_TRIES : 1); i++) {
+        int table = JOIN_ANY;
+        player_id_t want = seat->seat;
+        if (poker_connect_to_table(seat->conn, &table, &want) == 0) {
+            seat->table = table;
+            seat->seat = want;
+            return 0;
+        }
+        if (waitpid(server, NULL, WNOHANG) == server) return -1;
+        nanosleep(&tick, NULL);
+    }
+    return -1;
+}
+
+// ---------------------------- results ---------------------------- //
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(double *sorted, size_t n, double p) {
+    return n ? sorted[(size_t)(p * (n - 1))] : 0;
+}
+
+int main(int argc, char *argv[]) {
+    int seats = argc > 1 ? atoi(argv[1]) : 60;
+    int tables = argc > 2 ? atoi(argv[2]) : 10;
+    hands_per_seat = argc > 3 ? atoi(argv[3]) : 20;
+    for (int i = 0; argc > 4 && i < 3; i++) {
+        if (strcmp(argv[4], STRATEGY_NAMES[i]) == 0) strategy = i;
+    }
+    int num_threads = argc > 5 ? atoi(argv[5]) : 1;
+    if (tables < 1 || seats < 2 * tables || seats > MAX_PLAYERS * tables || hands_per_seat < 1 || num_threads < 1) {
+        fprintf(stderr, "usage: %s [seats] [tables] [hands] [check|random|aggressive] [threads] [server flags...]\n"
+                        "  every table needs 2 to %d seats\n", argv[0], MAX_PLAYERS);
+        return 1;
+    }
+    if (num_threads > seats) num_threads = seats;
+    signal(SIGPIPE, SIG_IGN);
+
+    pid_t server = start_server(argv[0], tables, seats / tables, argv + (argc > 6 ? 6 : argc), argc > 6 ? argc - 6 : 0);
+    if (server < 0) {
+        perror("fork");
+        return 1;
+    }
+
+    // seats join table by table, asking for seat 0 up to the size of the table: a seat that is
+    // taken at every table still seating opens the next one, so every table gets the seats it should
+    seat_t *all = calloc(seats, sizeof(seat_t));
+    worker_t *workers = calloc(num_threads, sizeof(worker_t));
+    for (int t = 0; t < num_threads; t++) {
+        workers[t].seats = all + (long)t * seats / num_threads;
+        workers[t].num_seats = (long)(t + 1) * seats / num_threads - (long)t * seats / num_threads;
+        rng_seed(&workers[t].rng, RNG_XOSHIRO, t + 1);
+    }
+    int joined = 0;
+    for (int table = 0, i = 0; table < tables; table++) {
+        int size = seats / tables + (table < seats % tables);
+        for (int s = 0; s < size; s++, i++) {
+            seat_t *seat = &all[i];
+            seat->worker = &workers[(long)i * num_threads / seats];
+            seat->seat = s;
+            seat->conn = poker_conn_create();
+            if (join(seat, server, i == 0) < 0) break;
+            poker_conn_set_data(seat->conn, seat);
+            poker_set_on_info_packet_handler(seat->conn, on_info);
+            poker_set_on_end_packet_handler(seat->conn, on_end);
+            joined++;
+        }
+    }
+    if (joined < seats) {
+        fprintf(stderr, "only %d of %d seats could join\n", joined, seats);
+        kill(server, SIGTERM);
+        waitpid(server, NULL, 0);
+        return 1;
+    }
+
+    double server_cpu = process_cpu_sec(server), own_cpu = self_cpu_sec();
+    double start = now_sec(CLOCK_MONOTONIC);
+    for (int i = 0; i < seats; i++) {
+        client_packet_t ready = { .packet_type = READY };
+        poker_send_packet_async(all[i].conn, &ready, NULL, NULL);
+    }
+    for (int t = 0; t < num_threads; t++) pthread_create(&workers[t].thread, NULL, run_worker, &workers[t]);
+    for (int t = 0; t < num_threads; t++) pthread_join(workers[t].thread, NULL);
+    double seconds = now_sec(CLOCK_MONOTONIC) - start;
+    server_cpu = process_cpu_sec(server) - server_cpu;
+    own_cpu = self_cpu_sec() - own_cpu;
+
+    // every seat at a table sees the same ENDs until it leaves, so a table played as many hands as its longest staying seat
+    int *table_hands = calloc(seats, sizeof(int));
+    long hands = 0, actions = 0, nacks = 0;
+    int stalled = 0, busted = 0;
+    size_t num_latencies = 0;
+    for (int i = 0; i < seats; i++) {
+        if (all[i].table >= 0 && all[i].table < seats && all[i].hands > table_hands[all[i].table]) table_hands[all[i].table] = all[i].hands;
+        busted += all[i].busted;
+    }
+    for (int i = 0; i < seats; i++) hands += table_hands[i];
+    for (int t = 0; t < num_threads; t++) {
+        actions += workers[t].actions;
+        nacks += workers[t].nacks;
+        stalled += workers[t].stalled;
+        num_latencies += workers[t].num_latencies;
+    }
+    double *latencies = malloc((num_latencies + 1) * sizeof(double));
+    for (int t = 0, n = 0; t < num_threads; t++) {
+        memcpy(latencies + n, workers[t].latencies, workers[t].num_latencies * sizeof(double));
+        n += workers[t].num_latencies;
+    }
+    qsort(latencies, num_latencies, sizeof(double), compare_double);
+
+    printf("%d seats at %d tables, %d hands a seat, %s, %d client thread%s\n", seats, tables, hands_per_seat,
+           STRATEGY_NAMES[strategy], num_threads, num_threads > 1 ? "s" : "");
+    printf("%9.0f hands/s %9.0f actions/s   %ld hands, %ld actions and %ld NACKs in %.2f s\n",
+           hands / seconds, actions / seconds, hands, actions, nacks, seconds);
+    printf("action to INFO  p50 %8.1f us   p99 %8.1f us   p99.9 %8.1f us   max %8.1f us\n",
+           percentile(latencies, num_latencies, 0.5) * 1e6, percentile(latencies, num_latencies, 0.99) * 1e6,
+           percentile(latencies, num_latencies, 0.999) * 1e6, percentile(latencies, num_latencies, 1) * 1e6);
+    printf("server CPU %5.1f%% of a core, %6.2f us/action   load generator CPU %5.1f%% of a core\n",
+           server_cpu * 100 / seconds, actions ? server_cpu * 1e6 / actions : 0, own_cpu * 100 / seconds);
+    if (busted) printf("%d seats went broke before their last hand\n", busted);
+
+    if (stalled) {
+        fprintf(stderr, "the tables stalled with %d seats still connected\n", stalled);
+        kill(server, SIGTERM);
+        waitpid(server, NULL, 0);
+    } else {
+        stop_server(server);
+    }
+    for (int i = 0; i < seats; i++) poker_conn_destroy(all[i].conn);
+    for (int t = 0; t < num_threads; t++) free(workers[t].latencies);
+    free(latencies);
+    free(table_hands);
+    free(workers);
+    free(all);
+    return stalled != 0;
+}
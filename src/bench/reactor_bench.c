@@ -0,0 +1,184 @@
+/**
+ * Times the reactor backends on loopback, with the traffic of tables in the betting loop.
+ *
+ * every table is six connections. each round, one player of every table sends an action, and
+ * the server answers the way table_on_packet does through betting_act: an ACK to that player
+ * and an INFO to the whole table. the server runs one reactor on its own thread, flushing after
+ * every poll the way a worker flushes after running its tables, while the clients block in plain
+ * send() and recv()
+ *
+ *  epoll:     one epoll_wait per poll, then one read() per readable socket and one send() per socket
+ *  io_uring:  multishot recv into provided buffers, every send of a poll submitted together
+ *
+ * besides the actions per second it reports the CPU time the server thread spent per action,
+ * which is where the system calls the io_uring backend saves show up. every client must get
+ * every packet it was sent, the benchmark exits with 1 if not
+ *
+ * usage: ./build/bench.reactor_bench [tables] [rounds] [epoll|io_uring]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "reactor.h"
+#include "macros.h"
+#include "wire.h"
+
+// The server side of one run
+typedef struct {
+    reactor_t *reactor;
+    int *fds;               // the accepted connections, in the order the clients connected
+    int num_fds;
+    int stop;
+    double cpu_sec;         // CPU time of the server thread
+} bench_server_t;
+
+static bench_server_t server;
+
+static double now_sec(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void set_nodelay(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+static void on_accept(reactor_t *reactor, int listen_fd, int fd, void *data) {
+    set_nodelay(fd);
+    server.fds[server.num_fds] = fd;
+    reactor_add(reactor, fd, (void *)(intptr_t)server.num_fds);
+    server.num_fds++;
+}
+
+// Answers an action like betting_act: an ACK to the player, then an INFO to the whole table
+static void on_packet(reactor_t *reactor, int fd, const client_packet_t *pkt, void *data) {
+    int seat = (int)(intptr_t)data;
+    int table = seat / MAX_PLAYERS;
+
+    server_packet_t reply;
+    memset(&reply, 0, sizeof(reply));
+    reply.packet_type = ACK;
+    reactor_send(reactor, fd, &reply, sizeof(reply));
+
+    reply.packet_type = INFO;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        reactor_send(reactor, server.fds[table * MAX_PLAYERS + i], &reply, sizeof(reply));
+    }
+}
+
+static void *server_main(void *arg) {
+    double start = now_sec(CLOCK_THREAD_CPUTIME_ID);
+    while (!__atomic_load_n(&server.stop, __ATOMIC_ACQUIRE)) {
+        if (reactor_poll(server.reactor, -1) < 0) break;
+        reactor_flush(server.reactor);
+    }
+    server.cpu_sec = now_sec(CLOCK_THREAD_CPUTIME_ID) - start;
+    return NULL;
+}
+
+// Receives exactly count packets on a client socket
+static int recv_packets(int fd, int count) {
+    server_packet_t packets[2];
+    size_t size = count * sizeof(server_packet_t);
+    return recv(fd, packets, size, MSG_WAITALL) == (ssize_t)size ? 0 : -1;
+}
+
+// Plays rounds of actions on tables * 6 connections through one backend, 0 if every packet arrived
+static int run(reactor_backend_t backend, const char *name, int tables, int rounds) {
+    int num_clients = tables * MAX_PLAYERS;
+    memset(&server, 0, sizeof(server));
+    server.fds = calloc(num_clients, sizeof(int));
+    server.reactor = reactor_create(backend, on_accept, on_packet, NULL);
+    if (!server.fds || !server.reactor) return -1;
+
+    // an ephemeral loopback port, so the benchmark runs next to a server
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t address_len = sizeof(address);
+    if (bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(listen_fd, SOMAXCONN) < 0 ||
+        getsockname(listen_fd, (struct sockaddr *)&address, &address_len) < 0) {
+        perror("listening on loopback failed");
+        return -1;
+    }
+    reactor_listen(server.reactor, listen_fd, NULL);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, server_main, NULL);
+
+    int *clients = calloc(num_clients, sizeof(int));
+    for (int i = 0; i < num_clients; i++) {
+        clients[i] = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(clients[i], (struct sockaddr *)&address, sizeof(address)) < 0) {
+            perror("connect failed");
+            return -1;
+        }
+        set_nodelay(clients[i]);
+    }
+    while (__atomic_load_n(&server.num_fds, __ATOMIC_ACQUIRE) < num_clients) sched_yield();
+
+    int failed = 0;
+    client_packet_t action = { .packet_type = CHECK };
+    double start = now_sec(CLOCK_MONOTONIC);
+    for (int round = 0; round < rounds && !failed; round++) {
+        int seat = round % MAX_PLAYERS;
+        for (int table = 0; table < tables; table++) {
+            send(clients[table * MAX_PLAYERS + seat], &action, WIRE_RAW_CLIENT, 0);
+        }
+        for (int i = 0; i < num_clients && !failed; i++) {
+            if (recv_packets(clients[i], i % MAX_PLAYERS == seat ? 2 : 1) < 0) failed = 1;
+        }
+    }
+    double seconds = now_sec(CLOCK_MONOTONIC) - start;
+
+    __atomic_store_n(&server.stop, 1, __ATOMIC_RELEASE);
+    reactor_wakeup(server.reactor);
+    pthread_join(thread, NULL);
+
+    long actions = (long)tables * rounds;
+    long packets = actions * (MAX_PLAYERS + 1);
+    printf("%-9s %4d tables %9.0f actions/s %9.0f packets/s %7.2f us server CPU/action\n", name, tables,
+           actions / seconds, packets / seconds, server.cpu_sec * 1e6 / actions);
+    if (failed) fprintf(stderr, "  %s lost packets\n", name);
+
+    for (int i = 0; i < num_clients; i++) close(clients[i]);
+    for (int i = 0; i < server.num_fds; i++) {
+        reactor_remove(server.reactor, server.fds[i]);
+        close(server.fds[i]);
+    }
+    reactor_remove(server.reactor, listen_fd);
+    close(listen_fd);
+    reactor_destroy(server.reactor);
+    free(clients);
+    free(server.fds);
+    return failed;
+}
+
+int main(int argc, char *argv[]) {
+    int tables = argc > 1 ? atoi(argv[1]) : 64;
+    int rounds = argc > 2 ? atoi(argv[2]) : 2000;
+    const char *only = argc > 3 ? argv[3] : NULL;
+    int failed = 0;
+
+    if (!only || strcmp(only, "epoll") == 0) failed |= run(REACTOR_EPOLL, "epoll", tables, rounds) != 0;
+    if (!only || strcmp(only, "io_uring") == 0) {
+        if (reactor_backend_available(REACTOR_IO_URING)) failed |= run(REACTOR_IO_URING, "io_uring", tables, rounds) != 0;
+        else printf("io_uring  not available on this kernel\n");
+    }
+    return failed;
+}
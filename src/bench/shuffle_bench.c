@@ -0,0 +1,166 @@
+/**
+ * Times shuffling a deck with every generator a table can use.
+ *
+ *  rand():        shuffle_deck on the global rand() state, what every table used to share
+ *  rng legacy:    the same sequence from a per table state
+ *  rng xoshiro:   xoshiro256** with a Fisher-Yates shuffle
+ *  rng chacha:    the secure mode, ChaCha20 reseeded from getrandom() in batches
+ *  getrandom():   a Fisher-Yates shuffle on bytes from one getrandom() call per hand, the naive
+ *                 secure shuffle rng chacha has to beat
+ *
+ * then it times whole hands through deck_t, which only shuffles as far as cards are dealt: 12
+ * cards for a six handed hand that ends preflop, 17 for one that reaches the river.
+ *
+ * the legacy generator must deal exactly what rand() deals, and drawing all 52 cards from a deck
+ * must deal exactly what rng_shuffle_deck deals, the benchmark exits with 1 if not
+ *
+ * usage: ./build/bench.shuffle_bench [shuffles] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/random.h>
+
+#include "game_logic.h"
+#include "rng.h"
+#include "deck.h"
+
+#define PREFLOP_CARDS (2 * MAX_PLAYERS)
+#define RIVER_CARDS (2 * MAX_PLAYERS + MAX_COMMUNITY_CARDS)
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *path, long shuffles, double seconds, long checksum) {
+    printf("%-16s %10.2f Mshuffles/s %8.1f ns/shuffle  (checksum %ld)\n", path, shuffles / seconds / 1e6,
+           seconds * 1e9 / shuffles, checksum);
+}
+
+// Sums where every card ends up so the shuffles cannot be optimized away
+static long deck_checksum(const card_t deck[DECK_SIZE]) {
+    long sum = 0;
+    for (int i = 0; i < DECK_SIZE; i++) sum += (long)deck[i] * (i + 1);
+    return sum;
+}
+
+int main(int argc, char *argv[]) {
+    long shuffles = argc > 1 ? atol(argv[1]) : 2000000;
+    int seed = argc > 2 ? atoi(argv[2]) : 1;
+    int failed = 0;
+
+    card_t deck[DECK_SIZE];
+    card_t legacy_deck[DECK_SIZE];
+    long checksum = 0;
+    long legacy_checksum = 0;
+
+    init_deck(deck, seed);
+    double start = now_sec();
+    for (long i = 0; i < shuffles; i++) {
+        shuffle_deck(deck);
+        checksum += deck_checksum(deck);
+    }
+    report("rand()", shuffles, now_sec() - start, checksum);
+
+    rng_t rng;
+    init_deck(legacy_deck, seed);
+    rng_seed(&rng, RNG_LEGACY, (uint32_t)seed);
+    start = now_sec();
+    for (long i = 0; i < shuffles; i++) {
+        rng_shuffle_deck(&rng, legacy_deck);
+        legacy_checksum += deck_checksum(legacy_deck);
+    }
+    report("rng legacy", shuffles, now_sec() - start, legacy_checksum);
+
+    if (legacy_checksum != checksum || memcmp(deck, legacy_deck, sizeof(deck)) != 0) {
+        fprintf(stderr, "rng legacy does not deal what rand() deals\n");
+        failed = 1;
+    }
+
+    checksum = 0;
+    rng_seed(&rng, RNG_XOSHIRO, rng_table_seed(seed, 0));
+    start = now_sec();
+    for (long i = 0; i < shuffles; i++) {
+        rng_shuffle_deck(&rng, deck);
+        checksum += deck_checksum(deck);
+    }
+    report("rng xoshiro", shuffles, now_sec() - start, checksum);
+
+    checksum = 0;
+    rng_seed(&rng, RNG_CHACHA, 0);
+    start = now_sec();
+    for (long i = 0; i < shuffles; i++) {
+        rng_shuffle_deck(&rng, deck);
+        checksum += deck_checksum(deck);
+    }
+    report("rng chacha", shuffles, now_sec() - start, checksum);
+
+    checksum = 0;
+    start = now_sec();
+    for (long i = 0; i < shuffles; i++) {
+        // 16 bits per swap is slightly biased, which is fine for timing
+        uint16_t random[DECK_SIZE];
+        if (getrandom(random, sizeof(random), 0) != sizeof(random)) {
+            perror("getrandom");
+            return 1;
+        }
+        for (int j = DECK_SIZE - 1; j > 0; j--) {
+            int k = random[j] % (j + 1);
+            card_t temp = deck[j];
+            deck[j] = deck[k];
+            deck[k] = temp;
+        }
+        checksum += deck_checksum(deck);
+    }
+    report("getrandom()", shuffles, now_sec() - start, checksum);
+
+    // ---------------------------- whole hands ---------------------------- //
+
+    const rng_mode_t modes[] = {RNG_LEGACY, RNG_XOSHIRO, RNG_CHACHA};
+    const char *mode_names[] = {"legacy", "xoshiro", "chacha"};
+    const int hand_cards[] = {PREFLOP_CARDS, RIVER_CARDS};
+
+    for (int m = 0; m < 3; m++) {
+        for (int h = 0; h < 2; h++) {
+            deck_t hand_deck;
+            deck_init(&hand_deck, modes[m], rng_table_seed(seed, 0));
+
+            checksum = 0;
+            start = now_sec();
+            for (long i = 0; i < shuffles; i++) {
+                deck_reset(&hand_deck);
+                for (int c = 0; c < hand_cards[h]; c++) checksum += (long)deck_draw(&hand_deck) * (c + 1);
+            }
+
+            char path[32];
+            snprintf(path, sizeof(path), "deck %s %d", mode_names[m], hand_cards[h]);
+            report(path, shuffles, now_sec() - start, checksum);
+        }
+    }
+
+    // drawing a whole deck one card at a time is the same shuffle as doing it all at once, legacy
+    // deals from the top of the shuffled deck and the others from the bottom
+    for (int m = 0; m < 2; m++) {
+        deck_t lazy;
+        deck_init(&lazy, modes[m], rng_table_seed(seed, 1));
+        deck_reset(&lazy);
+        card_t drawn[DECK_SIZE];
+        for (int c = 0; c < DECK_SIZE; c++) {
+            drawn[modes[m] == RNG_LEGACY ? c : DECK_SIZE - 1 - c] = deck_draw(&lazy);
+        }
+
+        init_deck(deck, 0);
+        rng_seed(&rng, modes[m], rng_table_seed(seed, 1));
+        rng_shuffle_deck(&rng, deck);
+        if (memcmp(drawn, deck, sizeof(deck)) != 0) {
+            fprintf(stderr, "deck %s deals differently from rng_shuffle_deck\n", mode_names[m]);
+            failed = 1;
+        }
+    }
+
+    return failed;
+}
@@ -5,6 +5,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <poll.h>
 
 #include "logs.h"
 #include "poker_client.h"
@@ -725,6 +726,34 @@ static void draw_end_info(end_packet_t* pkt)
     
 }
 
+static void on_halt();
+
+// waits for the next key, handing whatever the server sends in the meantime to the handlers,
+// so a HALT, or an INFO after the player ran out of time, gets through before the next click
+static int wait_for_key()
+{
+    struct pollfd fds[2] = {
+        { .fd = STDIN_FILENO, .events = POLLIN },
+        { .fd = client_fd(), .events = POLLIN },
+    };
+    while (true)
+    {
+        // what curses already read off the terminal, like the rest of a mouse event, does not make stdin readable
+        timeout(0);
+        int ch = getch();
+        timeout(-1);
+        if (ch != ERR) return ch;
+
+        // a resize interrupts the wait, and getch has the KEY_RESIZE
+        if (poll(fds, 2, -1) < 0) continue;
+        if (fds[1].revents && poll_packets() < 0)
+        {
+            log_err("lost the connection to the server.");
+            on_halt();
+        }
+    }
+}
+
 static void ready_leave_screen(end_packet_t *pkt)
 {
     char *ready_leave_buttons[] = { " READY  ", "  LEAVE " }; 
@@ -761,7 +790,7 @@ static void ready_leave_screen(end_packet_t *pkt)
     MEVENT event;
     while (true)
     {
-        ch = getch();
+        ch = wait_for_key();
         if (ch == KEY_MOUSE)
         {
             getmouse(&event);
@@ -852,7 +881,7 @@ static void poker_game_screen(info_packet_t *pkt)
         MEVENT event;
         while (true)
         {
-            ch = getch();
+            ch = wait_for_key();
             if (ch == KEY_MOUSE)
             {
                 getmouse(&event);
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <time.h>
 #include <arpa/inet.h>
@@ -9,19 +10,43 @@
 #include "poker_client.h"
 #include "utility.h"
 #include "logs.h"
+#include "wire.h"
 
 #define SERVER_IP   "127.0.0.1"
 #define BASE_PORT 2201
 #define NUM_PORTS 6
 #define BUFFER_SIZE 1024
+#define MAX_PENDING 64      // packets of send_packet_async that can wait for a response at once
+
+// A packet of send_packet_async whose ACK or NACK has not arrived yet
+typedef struct {
+    unsigned seq;       // 0 for a free slot
+    reply_packet_handler_t handler;
+    void *data;
+} pending_reply_t;
+
+// Everything about one connection to the server, nothing is shared between two of them
+struct poker_conn {
+    int fd;
+    poker_info_handler_t info_handler;
+    poker_end_handler_t end_handler;
+    poker_halt_handler_t halt_handler;
+    void *data;                             // whatever the caller keeps with the connection
+    server_packet_t last_server_packet;
+    int halt_received;
+    int wire;                               // the format the server agreed to at JOIN
+    uint8_t rx_buf[BUFFER_SIZE];            // bytes received that are not a whole packet yet
+    size_t rx_len;
+    wire_base_t rx_base;                    // the last INFO received, what a delta applies to
+    unsigned last_seq;                      // the number of the last packet sent
+    pending_reply_t pending[MAX_PENDING];   // by seq % MAX_PENDING
+};
 
 // Static vars
-static int client_fd = -1;
-static info_packet_handler_t info_handler = NULL;
+static poker_conn_t default_conn = { .fd = -1 };   // the connection of the functions that take none
+static info_packet_handler_t info_handler = NULL;   // the default connection's handlers, which take no connection
 static end_packet_handler_t end_handler = NULL;
 static on_halt_packet_handler_t halt_handler = NULL;
-static server_packet_t last_server_packet;
-static int halt_received = 0;
 
 static const char *CLIENT_PACKET_TYPE_NAMES[] = {
     "JOIN",
@@ -30,7 +55,8 @@ static const char *CLIENT_PACKET_TYPE_NAMES[] = {
     "RAISE",
     "CALL",
     "CHECK",
-    "FOLD"
+    "FOLD",
+    "SNAPSHOT"
 };
 
 static const char *SERVER_PACKET_TYPE_NAMES[] = {
@@ -85,18 +111,55 @@ void log_end_packet(const end_packet_t *end) {
     }
 }
 
+// ---------------------------- Connections ---------------------------- //
+
+poker_conn_t *poker_conn_create(void) {
+    poker_conn_t *conn = calloc(1, sizeof(poker_conn_t));
+    if (!conn) {
+        log_err("calloc failed in poker_conn_create");
+        return NULL;
+    }
+    conn->fd = -1;
+    return conn;
+}
+
+void poker_conn_destroy(poker_conn_t *conn) {
+    if (!conn) return;
+    poker_disconnect_to_serv(conn);
+    free(conn);
+}
+
+void poker_conn_set_data(poker_conn_t *conn, void *data) {
+    conn->data = data;
+}
+
+void *poker_conn_data(poker_conn_t *conn) {
+    return conn->data;
+}
+
 // ---------------------------- Networking Functions ---------------------------- //
 
 #define NANOSEC_IN_SEC 1000000000ul
 #define MAX_CONNECTION_ATTEMPT_TIME 7500000000ul
 
-int connect_to_serv(player_id_t player_id) {
+// Forgets everything about the last connection, the next one starts out raw
+static void reset_connection(poker_conn_t *conn) {
+    conn->wire = WIRE_RAW;
+    conn->rx_len = 0;
+    conn->rx_base.valid = 0;
+    conn->last_seq = 0;
+    conn->halt_received = 0;
+    memset(conn->pending, 0, sizeof(conn->pending));
+}
+
+int poker_connect_to_serv(poker_conn_t *conn, player_id_t player_id) {
     struct sockaddr_in serv_addr;
 
     int port = BASE_PORT + player_id;
 
-    client_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (client_fd < 0) {
+    reset_connection(conn); // a plain JOIN cannot ask for anything but raw
+    conn->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (conn->fd < 0) {
         log_err("socket failed in connect_to_serv");
         return -1;
     }
@@ -107,8 +170,8 @@ int connect_to_serv(player_id_t player_id) {
 
     if (inet_pton(AF_INET, SERVER_IP, &serv_addr.sin_addr) <= 0) {
         log_err("inet_pton failed in connect_to_serv");
-        close(client_fd);
-        client_fd = -1;
+        close(conn->fd);
+        conn->fd = -1;
         return -1;
     }
 
@@ -117,7 +180,7 @@ int connect_to_serv(player_id_t player_id) {
     struct timespec tm;
     for (size_t timer = 100000000; timer < MAX_CONNECTION_ATTEMPT_TIME; timer *= 2)
     {
-        if (connect(client_fd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) >= 0) 
+        if (connect(conn->fd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) >= 0)
         {
             connection_success = 1;
             break;
@@ -128,12 +191,12 @@ int connect_to_serv(player_id_t player_id) {
         tm.tv_nsec = timer % NANOSEC_IN_SEC;
         nanosleep(&tm, NULL);
     }
-    
+
 
     if (!connection_success) {
         log_err("connect failed in connect_to_serv");
-        close(client_fd);
-        client_fd = -1;
+        close(conn->fd);
+        conn->fd = -1;
         return -1;
     }
 
@@ -144,7 +207,7 @@ int connect_to_serv(player_id_t player_id) {
 
     log_info("[Client ~> Server] Sending packet: type=%s", CLIENT_PACKET_TYPE_NAMES[pkt.packet_type]);
 
-    if (send(client_fd, &pkt, sizeof(client_packet_t), 0) <= 0) {
+    if (send(conn->fd, &pkt, WIRE_RAW_CLIENT, 0) <= 0) {
         log_err("send failed in join.");
         return -1;
     }
@@ -152,36 +215,144 @@ int connect_to_serv(player_id_t player_id) {
     return 0;
 }
 
-int disconnect_to_serv() {
-    if (client_fd >= 0) {
-        close(client_fd);
-        client_fd = -1;
+int poker_connect_to_table(poker_conn_t *conn, int *table, player_id_t *seat) {
+    struct sockaddr_in serv_addr;
+
+    reset_connection(conn); // the JOIN and its answer are always raw
+    conn->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (conn->fd < 0) {
+        log_err("socket failed in connect_to_table");
+        return -1;
+    }
+
+    memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(BASE_PORT); // every table and seat is behind the first port
+    inet_pton(AF_INET, SERVER_IP, &serv_addr.sin_addr);
+
+    if (connect(conn->fd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
+        log_err("connect failed in connect_to_table");
+        close(conn->fd);
+        conn->fd = -1;
+        return -1;
+    }
+
+    client_packet_t pkt = { .packet_type = JOIN };
+    pkt.params[0] = JOIN_REQUEST(*table, *seat) | JOIN_WIRE(WIRE_VERSION);
+    log_info("[Client ~> Server] Sending packet: type=%s, table=%d, seat=%d", CLIENT_PACKET_TYPE_NAMES[pkt.packet_type], *table, *seat);
+
+    server_packet_t response;
+    if (send(conn->fd, &pkt, WIRE_RAW_CLIENT, 0) <= 0 || recv(conn->fd, &response, sizeof(server_packet_t), MSG_WAITALL) <= 0) {
+        log_err("JOIN failed in connect_to_table");
+        close(conn->fd);
+        conn->fd = -1;
+        return -1;
+    }
+
+    log_info("[Server ~> Client] Received response packet: type=%s", SERVER_PACKET_TYPE_NAMES[response.packet_type]);
+    if (response.packet_type != ACK) {
+        close(conn->fd);
+        conn->fd = -1;
+        return -1;
+    }
+
+    *table = response.join.table;
+    *seat = response.join.seat;
+    // a server that does not know the compact format left join.wire at 0
+    if (response.join.wire > WIRE_RAW && response.join.wire <= WIRE_VERSION) conn->wire = response.join.wire;
+    return 0;
+}
+
+int poker_disconnect_to_serv(poker_conn_t *conn) {
+    if (conn->fd >= 0) {
+        close(conn->fd);
+        conn->fd = -1;
         return 0;
     }
     return -1;
 }
 
-int send_packet(client_packet_t *pkt) {
-    if (!pkt || client_fd < 0) return -1;
+// Takes the first whole packet out of what was received, 1 if there was one, 0 if not yet, -1 on bad bytes
+static int take_packet(poker_conn_t *conn, server_packet_t *pkt) {
+    size_t used;
+    int decoded = wire_decode_server(conn->wire, conn->rx_buf, conn->rx_len, &conn->rx_base, pkt, &used);
+    if (decoded > 0) {
+        conn->rx_len -= used;
+        memmove(conn->rx_buf, conn->rx_buf + used, conn->rx_len);
+    }
+    return decoded;
+}
+
+// Takes the next whole packet off the connection, receiving more whenever what is buffered is not one yet
+static int read_packet(poker_conn_t *conn, server_packet_t *pkt) {
+    while (1) {
+        int taken = take_packet(conn, pkt);
+        if (taken < 0) return -1;
+        if (taken > 0) return 0;
+
+        ssize_t nbytes = recv(conn->fd, conn->rx_buf + conn->rx_len, sizeof(conn->rx_buf) - conn->rx_len, 0);
+        if (nbytes <= 0) return -1;
+        conn->rx_len += nbytes;
+    }
+}
+
+// Whether the server answers a packet with an ACK or NACK
+static int has_response(const client_packet_t *pkt) {
+    return pkt->packet_type != READY && pkt->packet_type != LEAVE && pkt->packet_type != SNAPSHOT;
+}
 
+// Numbers a packet and sends it in the connection's wire format
+static int write_packet(poker_conn_t *conn, client_packet_t *pkt) {
     if (pkt->packet_type == RAISE)
         log_info("[Client ~> Server] Sending packet: type=%s, param[0]=%d", CLIENT_PACKET_TYPE_NAMES[pkt->packet_type], pkt->params[0]);
     else
         log_info("[Client ~> Server] Sending packet: type=%s", CLIENT_PACKET_TYPE_NAMES[pkt->packet_type]);
 
-    if (send(client_fd, pkt, sizeof(client_packet_t), 0) <= 0) {
+    if (++conn->last_seq == 0) conn->last_seq = 1; // 0 is what the server answers with for nobody
+    pkt->seq = conn->last_seq;
+    uint8_t frame[WIRE_MAX_FRAME];
+    size_t len = wire_encode_client(conn->wire, pkt, frame);
+    return send(conn->fd, frame, len, 0) <= 0 ? -1 : 0;
+}
+
+// Hands the response to a packet of send_packet_async to its handler
+static void complete_reply(poker_conn_t *conn, const server_packet_t *pkt) {
+    unsigned seq = pkt->reply.seq;
+    pending_reply_t *slot = &conn->pending[seq % MAX_PENDING];
+    // a response to send_packet, or to an action the server took for a player out of time
+    if (conn->wire < WIRE_SEQ || seq == 0 || slot->seq != seq) return;
+
+    pending_reply_t done = *slot;
+    slot->seq = 0;
+    if (done.handler) done.handler(seq, pkt->packet_type == ACK, done.data);
+}
+
+static void dispatch_packet(poker_conn_t *conn, server_packet_t *pkt);
+
+int poker_send_packet(poker_conn_t *conn, client_packet_t *pkt) {
+    if (!pkt || conn->fd < 0) return -1;
+
+    if (write_packet(conn, pkt) < 0) {
         log_err("send failed in send_packet");
         return -1;
     }
 
-    if (pkt->packet_type == READY || pkt->packet_type == LEAVE) {
+    if (!has_response(pkt)) {
         return 0;
     }
 
+    // the INFO of a player who acted just before, or the response to a packet of send_packet_async,
+    // can come first and goes to its handler like any other
     server_packet_t response;
-    if (recv(client_fd, &response, sizeof(server_packet_t), 0) <= 0) {
-        log_err("recv failed after sending packet");
-        return -1;
+    while (1) {
+        if (read_packet(conn, &response) < 0) {
+            log_err("recv failed after sending packet");
+            return -1;
+        }
+        int reply = response.packet_type == ACK || response.packet_type == NACK;
+        // numbered responses only answer this packet if the number is its own
+        if (reply && (conn->wire < WIRE_SEQ || response.reply.seq == pkt->seq)) break;
+        dispatch_packet(conn, &response);
     }
 
     log_info("[Server ~> Client] Received response packet: type=%s", SERVER_PACKET_TYPE_NAMES[response.packet_type]);
@@ -189,106 +360,272 @@ int send_packet(client_packet_t *pkt) {
     return (response.packet_type == ACK) ? 0 : -1;
 }
 
-int recv_packet(server_packet_t *pkt) {
-    if (!pkt || client_fd < 0) return -1;
+unsigned poker_send_packet_async(poker_conn_t *conn, client_packet_t *pkt, reply_packet_handler_t handler, void *data) {
+    if (!pkt || conn->fd < 0 || conn->wire < WIRE_SEQ) return 0;
 
-    if (recv(client_fd, pkt, sizeof(server_packet_t), 0) <= 0) {
-        log_err("recv failed in recv_packet");
-        return -1;
+    // the slot of the next number has to be free, or the response it waits for would be lost
+    unsigned seq = conn->last_seq + 1 == 0 ? 1 : conn->last_seq + 1;
+    pending_reply_t *slot = &conn->pending[seq % MAX_PENDING];
+    if (has_response(pkt) && slot->seq) {
+        log_err("too many packets waiting for a response in send_packet_async");
+        return 0;
     }
 
-    memcpy(&last_server_packet, pkt, sizeof(server_packet_t));
+    if (write_packet(conn, pkt) < 0) {
+        log_err("send failed in send_packet_async");
+        return 0;
+    }
+    if (has_response(pkt)) *slot = (pending_reply_t){ .seq = pkt->seq, .handler = handler, .data = data };
+    return pkt->seq;
+}
+
+// Remembers a packet that was received and hands it to its handler
+static void dispatch_packet(poker_conn_t *conn, server_packet_t *pkt) {
+    memcpy(&conn->last_server_packet, pkt, sizeof(server_packet_t));
 
     switch (pkt->packet_type) {
         case INFO:
             log_info_packet(&(pkt->info));
-            if (info_handler) {
-                info_handler(&(pkt->info));
+            if (conn->info_handler) {
+                conn->info_handler(conn, &(pkt->info));
             }
             break;
         case END:
             log_end_packet(&(pkt->end));
-            if (end_handler) {
-                end_handler(&(pkt->end));
+            if (conn->end_handler) {
+                conn->end_handler(conn, &(pkt->end));
             }
             break;
         case HALT:
-            halt_received = 1;
+            conn->halt_received = 1;
             log_info("[Server ~> Client] Received HALT");
-            if (halt_handler) {
-                halt_handler();
+            if (conn->halt_handler) {
+                conn->halt_handler(conn);
             }
             break;
         case ACK:
             log_info("[Server ~> Client] Received ACK");
+            complete_reply(conn, pkt);
             break;
         case NACK:
             log_info("[Server ~> Client] Received NACK");
+            complete_reply(conn, pkt);
             break;
         default:
             log_info("[Server ~> Client] Received unknown packet type: %d", pkt->packet_type);
             break;
     }
+}
+
+int poker_recv_packet(poker_conn_t *conn, server_packet_t *pkt) {
+    if (!pkt || conn->fd < 0) return -1;
 
+    if (read_packet(conn, pkt) < 0) {
+        log_err("recv failed in recv_packet");
+        return -1;
+    }
+
+    dispatch_packet(conn, pkt);
     return 0;
 }
 
+int poker_poll_packets(poker_conn_t *conn) {
+    if (conn->fd < 0) return -1;
+
+    int handled = 0;
+    while (1) {
+        // a handler may read from the connection too, so the packets are taken one at a time
+        server_packet_t pkt;
+        int taken;
+        while ((taken = take_packet(conn, &pkt)) > 0) {
+            dispatch_packet(conn, &pkt);
+            handled++;
+            if (conn->fd < 0) return handled;
+        }
+        if (taken < 0) {
+            log_err("bad packet in poll_packets");
+            return -1;
+        }
+
+        // what is left is less than a packet, so there is always room for more
+        ssize_t nbytes = recv(conn->fd, conn->rx_buf + conn->rx_len, sizeof(conn->rx_buf) - conn->rx_len, MSG_DONTWAIT);
+        if (nbytes > 0) {
+            conn->rx_len += nbytes;
+        } else if (nbytes < 0 && errno == EINTR) {
+            continue;
+        } else if (nbytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return handled;
+        } else {
+            // the packets that came before the connection closed count, the next call says it closed
+            if (!handled) log_err("recv failed in poll_packets");
+            return handled ? handled : -1;
+        }
+    }
+}
+
+int poker_client_fd(poker_conn_t *conn) {
+    return conn->fd;
+}
+
 // ---------------------------- Info Packet Handler ---------------------------- //
 
+void poker_set_on_info_packet_handler(poker_conn_t *conn, poker_info_handler_t handler) {
+    conn->info_handler = handler;
+}
+
+void poker_set_on_end_packet_handler(poker_conn_t *conn, poker_end_handler_t handler) {
+    conn->end_handler = handler;
+}
+
+void poker_set_on_halt_packet_handler(poker_conn_t *conn, poker_halt_handler_t handler) {
+    conn->halt_handler = handler;
+}
+
+// ------------------------- Poker move functions --------------------------- //
+
+int poker_ready(poker_conn_t *conn) {
+    client_packet_t pkt = { .packet_type = READY };
+    return poker_send_packet(conn, &pkt);
+}
+
+int poker_check(poker_conn_t *conn) {
+    client_packet_t pkt = { .packet_type = CHECK };
+    return poker_send_packet(conn, &pkt);
+}
+
+int poker_bet_raise(poker_conn_t *conn, int new_bet) {
+    client_packet_t pkt = { .packet_type = RAISE };
+    pkt.params[0] = new_bet;
+    return poker_send_packet(conn, &pkt);
+}
+
+int poker_call(poker_conn_t *conn) {
+    client_packet_t pkt = { .packet_type = CALL };
+    return poker_send_packet(conn, &pkt);
+}
+
+int poker_fold(poker_conn_t *conn) {
+    client_packet_t pkt = { .packet_type = FOLD };
+    return poker_send_packet(conn, &pkt);
+}
+
+int poker_leave(poker_conn_t *conn) {
+    client_packet_t pkt = { .packet_type = LEAVE };
+    return poker_send_packet(conn, &pkt);
+}
+
+int poker_request_snapshot(poker_conn_t *conn) {
+    client_packet_t pkt = { .packet_type = SNAPSHOT };
+    return poker_send_packet(conn, &pkt);
+}
+
+// --------------------------- Utility functions ------------------------------- //
+
+int poker_is_players_turn(poker_conn_t *conn, player_id_t player_id) {
+    if (conn->last_server_packet.packet_type != INFO) {
+        return 0;
+    }
+    return (conn->last_server_packet.info.player_turn == player_id);
+}
+
+int poker_has_recv_halt(poker_conn_t *conn) {
+    return conn->halt_received;
+}
+
+// --------------------------- Default connection ------------------------------- //
+
+// The default connection's handlers, passing on to the ones that were given without a connection
+static void default_info_handler(poker_conn_t *conn, info_packet_t *info) {
+    info_handler(info);
+}
+
+static void default_end_handler(poker_conn_t *conn, end_packet_t *end) {
+    end_handler(end);
+}
+
+static void default_halt_handler(poker_conn_t *conn) {
+    halt_handler();
+}
+
+int connect_to_serv(player_id_t player_id) {
+    return poker_connect_to_serv(&default_conn, player_id);
+}
+
+int connect_to_table(int *table, player_id_t *seat) {
+    return poker_connect_to_table(&default_conn, table, seat);
+}
+
+int disconnect_to_serv() {
+    return poker_disconnect_to_serv(&default_conn);
+}
+
+int send_packet(client_packet_t *pkt) {
+    return poker_send_packet(&default_conn, pkt);
+}
+
+unsigned send_packet_async(client_packet_t *pkt, reply_packet_handler_t handler, void *data) {
+    return poker_send_packet_async(&default_conn, pkt, handler, data);
+}
+
+int recv_packet(server_packet_t *pkt) {
+    return poker_recv_packet(&default_conn, pkt);
+}
+
+int poll_packets() {
+    return poker_poll_packets(&default_conn);
+}
+
+int client_fd() {
+    return poker_client_fd(&default_conn);
+}
+
 void set_on_info_packet_handler(info_packet_handler_t handler) {
     info_handler = handler;
+    poker_set_on_info_packet_handler(&default_conn, handler ? default_info_handler : NULL);
 }
 
 void set_on_end_packet_handler(end_packet_handler_t handler) {
     end_handler = handler;
+    poker_set_on_end_packet_handler(&default_conn, handler ? default_end_handler : NULL);
 }
 
 void set_on_halt_packet_handler(on_halt_packet_handler_t handler) {
     halt_handler = handler;
+    poker_set_on_halt_packet_handler(&default_conn, handler ? default_halt_handler : NULL);
 }
 
-// ------------------------- Poker move functions --------------------------- //
-
 int ready() {
-    client_packet_t pkt = { .packet_type = READY };
-    return send_packet(&pkt);
+    return poker_ready(&default_conn);
 }
 
 int check() {
-    client_packet_t pkt = { .packet_type = CHECK };
-    return send_packet(&pkt);
+    return poker_check(&default_conn);
 }
 
 int bet_raise(int new_bet) {
-    client_packet_t pkt = { .packet_type = RAISE };
-    pkt.params[0] = new_bet;
-    return send_packet(&pkt);
+    return poker_bet_raise(&default_conn, new_bet);
 }
 
 int call() {
-    client_packet_t pkt = { .packet_type = CALL };
-    return send_packet(&pkt);
+    return poker_call(&default_conn);
 }
 
 int fold() {
-    client_packet_t pkt = { .packet_type = FOLD };
-    return send_packet(&pkt);
+    return poker_fold(&default_conn);
 }
 
 int leave() {
-    client_packet_t pkt = { .packet_type = LEAVE };
-    return send_packet(&pkt);
+    return poker_leave(&default_conn);
 }
 
-// --------------------------- Utility functions ------------------------------- //
+int request_snapshot() {
+    return poker_request_snapshot(&default_conn);
+}
 
 int is_players_turn(player_id_t player_id) {
-    if (last_server_packet.packet_type != INFO) {
-        return 0;
-    }
-    return (last_server_packet.info.player_turn == player_id);
+    return poker_is_players_turn(&default_conn, player_id);
 }
 
 int has_recv_halt() {
-    return halt_received;
-}
\ No newline at end of file
+    return poker_has_recv_halt(&default_conn);
+}
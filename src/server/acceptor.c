@@ -0,0 +1,168 @@
+#define _GNU_SOURCE // for SO_REUSEPORT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "acceptor.h"
+#include "wire.h"
+
+// ---------------------------- JOIN ---------------------------- //
+
+// Answers a JOIN_REQUEST, raw and straight on the socket since no table has it yet
+static void send_join_reply(int fd, server_packet_type_t type, int table_id, player_id_t seat, int wire) {
+    server_packet_t reply;
+    memset(&reply, 0, sizeof(server_packet_t));
+    reply.packet_type = type;
+    reply.join.table = table_id;
+    reply.join.seat = seat;
+    reply.join.wire = wire;
+    send(fd, &reply, sizeof(server_packet_t), 0);
+}
+
+static void on_accept(reactor_t *reactor, int listen_fd, int fd, void *data) {
+    printf("[Server] accept() successful at port %d \n", fd);
+    // a table sends a player several small packets in a row, which Nagle would hold back until the
+    // player's delayed ACK, up to 40ms a packet
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    // a player who stops reading must not block the thread sending to a whole worker's tables
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    // nothing past the JOIN is read here, the rest of the stream is for the table
+    if (reactor_expect(reactor, fd, data) < 0) close(fd);
+}
+
+static void on_join(reactor_t *reactor, int fd, const client_packet_t *pkt, void *data) {
+    listener_t *listener = data;
+    table_pool_t *pool = listener->acceptor->pool;
+
+    if (pkt->packet_type != JOIN) {
+        printf("[Server] Connection at port %d did not start with a JOIN, closing it.\n", fd);
+        send_join_reply(fd, NACK, JOIN_ANY, JOIN_ANY, WIRE_RAW);
+        close(fd);
+        return;
+    }
+
+    // a plain JOIN takes the seat of the port, the way the original clients pick their seat
+    int request = pkt->params[0] & JOIN_REQUEST_FLAG;
+    int table_id = request ? JOIN_REQUEST_TABLE(pkt->params[0]) : JOIN_ANY;
+    player_id_t seat = request ? JOIN_REQUEST_SEAT(pkt->params[0]) : listener->seat;
+    // the newest wire format both sides speak, the raw structs for a plain JOIN
+    int wire = request ? JOIN_REQUEST_WIRE(pkt->params[0]) : WIRE_RAW;
+    if (wire > WIRE_VERSION) wire = WIRE_VERSION;
+
+    table_t *table = table_pool_seat(pool, table_id, &seat, fd, wire);
+    if (!table) {
+        printf("[Server] No seat for the connection at port %d, closing it.\n", fd);
+        if (request) send_join_reply(fd, NACK, table_id, seat, WIRE_RAW);
+        close(fd);
+        return;
+    }
+    printf("[Server] Player %d sent JOIN packet successfully.\n", seat);
+    // the table reads nothing from the player before its READY, which only comes after the ACK
+    if (request) send_join_reply(fd, ACK, table->id, seat, wire);
+}
+
+static void on_close(reactor_t *reactor, int fd, void *data) {
+    close(fd);
+}
+
+// ---------------------------- Acceptors ---------------------------- //
+
+// Opens a listening socket on port, shared with the other acceptors if reuse_port is set
+static int open_listener(int port, int reuse_port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket failed");
+        return -1;
+    }
+
+    int opt = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) ||
+        (reuse_port && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)))) {
+        perror("[Server] setsockopt() failed.");
+        close(fd);
+        return -1;
+    }
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        perror("[Server] bind() failed.");
+        close(fd);
+        return -1;
+    }
+
+    // many tables can be filling up at once
+    if (listen(fd, SOMAXCONN) < 0) {
+        perror("[Server] listen() failed.");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int acceptor_init(acceptor_t *acceptor, table_pool_t *pool, int id, int seat_ports, reactor_backend_t backend) {
+    memset(acceptor, 0, sizeof(acceptor_t));
+    acceptor->id = id;
+    acceptor->pool = pool;
+    acceptor->reactor = reactor_create(backend, on_accept, on_join, on_close);
+    if (!acceptor->reactor) return -1;
+
+    int num_ports = seat_ports ? NUM_PORTS : 1;
+    for (int i = 0; i < num_ports; i++) {
+        listener_t *listener = &acceptor->listeners[i];
+        listener->seat = i;
+        listener->acceptor = acceptor;
+        // only the first port is shared, the seat ports belong to one acceptor
+        listener->fd = open_listener(BASE_PORT + i, i == 0);
+        if (listener->fd < 0 || reactor_listen(acceptor->reactor, listener->fd, listener) < 0) {
+            if (listener->fd >= 0) close(listener->fd);
+            acceptor_destroy(acceptor);
+            return -1;
+        }
+        acceptor->num_listeners++;
+        if (id == 0) printf("[Server] Running on port %d\n", BASE_PORT + i);
+    }
+    return 0;
+}
+
+void acceptor_destroy(acceptor_t *acceptor) {
+    for (int i = 0; i < acceptor->num_listeners; i++) {
+        close(acceptor->listeners[i].fd);
+    }
+    acceptor->num_listeners = 0;
+    reactor_destroy(acceptor->reactor);
+    acceptor->reactor = NULL;
+}
+
+static void *acceptor_main(void *arg) {
+    acceptor_t *acceptor = arg;
+    while (!__atomic_load_n(&acceptor->stop, __ATOMIC_ACQUIRE)) {
+        if (reactor_poll(acceptor->reactor, -1) < 0) break;
+    }
+    return NULL;
+}
+
+int acceptor_start(acceptor_t *acceptor) {
+    if (pthread_create(&acceptor->thread, NULL, acceptor_main, acceptor) != 0) {
+        perror("[Server] pthread_create() failed.");
+        return -1;
+    }
+    return 0;
+}
+
+void acceptor_stop(acceptor_t *acceptor) {
+    __atomic_store_n(&acceptor->stop, 1, __ATOMIC_RELEASE);
+    reactor_wakeup(acceptor->reactor);
+    pthread_join(acceptor->thread, NULL);
+}
@@ -116,9 +116,7 @@ void build_info_packet(game_state_t *game, player_id_t pid, server_packet_t *out
         out->info.player_bets[i] = game->current_bets[i];
     }
 
-    for (int i = 0; i < HAND_SIZE; i++) {
-        out->info.player_cards[i] = game->player_hands[pid][i];
-    }
+    patch_info_packet(game, pid, out);
 
     for (int i = 0; i < MAX_COMMUNITY_CARDS; i++) {
         out->info.community_cards[i] = game->community_cards[i];
@@ -141,6 +139,13 @@ void build_info_packet(game_state_t *game, player_id_t pid, server_packet_t *out
     }
 }
 
+// Turns an INFO built for one seat into the INFO of another, only the hole cards differ
+void patch_info_packet(game_state_t *game, player_id_t pid, server_packet_t *out) {
+    for (int i = 0; i < HAND_SIZE; i++) {
+        out->info.player_cards[i] = game->player_hands[pid][i];
+    }
+}
+
 void build_end_packet(game_state_t *game, player_id_t winner, server_packet_t *out) {
     out->packet_type = END;
     end_packet_t *end_info = &(out->end);
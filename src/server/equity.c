@@ -0,0 +1,331 @@
+#define _GNU_SOURCE // for SCHED_IDLE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "equity.h"
+#include "hand_eval.h"
+
+// sampled boards are handed out in chunks this big, each chunk seeded from its index alone
+#define CHUNK_BOARDS 4096
+// a pot is split in this many shares so splitting it between any 1 to 6 winners stays exact
+#define POT_SHARES 60
+
+// What the boards scored so far came to, kept in integers so the totals never depend on order
+typedef struct {
+    long boards;
+    long shares[MAX_PLAYERS];
+    long wins[MAX_PLAYERS];
+    long ties[MAX_PLAYERS];
+} tally_t;
+
+typedef struct {
+    const equity_request_t *request;
+    card_t deck[DECK_SIZE];     // every card that can still come on the board
+    int deck_size;
+    int missing;                // board cards left to deal
+    int exact;
+    long num_units;             // exact: one unit per lowest dealt card, sampled: one per chunk
+    long iterations;
+    double deadline;            // 0 for no time limit
+    long next_unit;
+    pthread_mutex_t lock;
+    tally_t total;
+} equity_job_t;
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// Number of ways to pick k cards out of n
+static long choose(int n, int k) {
+    if (k < 0 || k > n) return 0;
+    long ways = 1;
+    for (int i = 1; i <= k; i++) ways = ways * (n - k + i) / i;
+    return ways;
+}
+
+// Scores every player on a complete board and hands the pot to the best of them
+static void score_board(const equity_request_t *request, const card_t board[MAX_COMMUNITY_CARDS], tally_t *tally) {
+    int scores[MAX_PLAYERS];
+    hand_eval_batch(board, request->hole_cards, request->num_players, scores);
+
+    int best = -1;
+    int winners = 0;
+    for (int i = 0; i < request->num_players; i++) {
+        if (scores[i] > best) {
+            best = scores[i];
+            winners = 1;
+        } else if (scores[i] == best) {
+            winners++;
+        }
+    }
+
+    for (int i = 0; i < request->num_players; i++) {
+        if (scores[i] != best) continue;
+        tally->shares[i] += POT_SHARES / winners;
+        if (winners == 1) tally->wins[i]++;
+        else tally->ties[i]++;
+    }
+    tally->boards++;
+}
+
+// Deals every combination of the remaining board cards out of deck[from..]
+static void enumerate_boards(equity_job_t *job, card_t board[MAX_COMMUNITY_CARDS], int dealt, int from, tally_t *tally) {
+    if (dealt == MAX_COMMUNITY_CARDS) {
+        score_board(job->request, board, tally);
+        return;
+    }
+    for (int i = from; i < job->deck_size; i++) {
+        board[dealt] = job->deck[i];
+        enumerate_boards(job, board, dealt + 1, i + 1, tally);
+    }
+}
+
+// Exact unit: every board whose lowest dealt card is deck[unit]
+static void run_exact_unit(equity_job_t *job, long unit, tally_t *tally) {
+    card_t board[MAX_COMMUNITY_CARDS];
+    memcpy(board, job->request->board, job->request->num_board * sizeof(card_t));
+
+    if (job->missing == 0) {
+        score_board(job->request, board, tally);
+        return;
+    }
+    board[job->request->num_board] = job->deck[unit];
+    enumerate_boards(job, board, job->request->num_board + 1, unit + 1, tally);
+}
+
+// Sampled unit: CHUNK_BOARDS random boards (fewer for the last chunk) from the chunk's own seed
+static void run_sampled_unit(equity_job_t *job, long unit, tally_t *tally) {
+    uint64_t state = job->request->seed ^ (unit * 0xd1b54a32d192ed03ull);
+    long boards = job->iterations - unit * CHUNK_BOARDS;
+    if (boards > CHUNK_BOARDS) boards = CHUNK_BOARDS;
+
+    card_t deck[DECK_SIZE];
+    card_t board[MAX_COMMUNITY_CARDS];
+    memcpy(deck, job->deck, job->deck_size * sizeof(card_t));
+    memcpy(board, job->request->board, job->request->num_board * sizeof(card_t));
+
+    for (long b = 0; b < boards; b++) {
+        // partial Fisher-Yates, the first cards of the deck end up a uniform sample of it
+        for (int i = 0; i < job->missing; i++) {
+            int left = job->deck_size - i;
+            int j = i + (int)(((splitmix64(&state) >> 32) * (uint64_t)left) >> 32);
+            card_t temp = deck[i];
+            deck[i] = deck[j];
+            deck[j] = temp;
+            board[job->request->num_board + i] = deck[i];
+        }
+        score_board(job->request, board, tally);
+    }
+}
+
+static void *equity_thread(void *arg) {
+    equity_job_t *job = arg;
+    tally_t tally;
+    memset(&tally, 0, sizeof(tally));
+
+    long unit;
+    while ((unit = __atomic_fetch_add(&job->next_unit, 1, __ATOMIC_RELAXED)) < job->num_units) {
+        if (job->exact) {
+            run_exact_unit(job, unit, &tally);
+        } else {
+            if (job->deadline && now_sec() > job->deadline) break;
+            run_sampled_unit(job, unit, &tally);
+        }
+    }
+
+    pthread_mutex_lock(&job->lock);
+    job->total.boards += tally.boards;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        job->total.shares[i] += tally.shares[i];
+        job->total.wins[i] += tally.wins[i];
+        job->total.ties[i] += tally.ties[i];
+    }
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+// Removes every known card from the deck, returns -1 if a card is out of range or seen twice
+static int remove_known_cards(equity_job_t *job) {
+    const equity_request_t *request = job->request;
+    int seen[DECK_SIZE] = {0};
+    card_t known[MAX_PLAYERS * HAND_SIZE + MAX_COMMUNITY_CARDS];
+    int num_known = 0;
+
+    for (int i = 0; i < request->num_players; i++) {
+        known[num_known++] = request->hole_cards[i][0];
+        known[num_known++] = request->hole_cards[i][1];
+    }
+    for (int i = 0; i < request->num_board; i++) known[num_known++] = request->board[i];
+
+    for (int i = 0; i < num_known + request->num_dead; i++) {
+        card_t card = i < num_known ? known[i] : request->dead_cards[i - num_known];
+        if (card < 0 || card >= DECK_SIZE || seen[card]) return -1;
+        seen[card] = 1;
+    }
+
+    job->deck_size = 0;
+    for (card_t card = 0; card < DECK_SIZE; card++) {
+        if (!seen[card]) job->deck[job->deck_size++] = card;
+    }
+    return 0;
+}
+
+int equity_calculate(const equity_request_t *request, equity_result_t *result) {
+    if (request->num_players < 2 || request->num_players > MAX_PLAYERS) return -1;
+    if (request->num_board < 0 || request->num_board > MAX_COMMUNITY_CARDS) return -1;
+    if (request->num_dead < 0 || (request->num_dead > 0 && !request->dead_cards)) return -1;
+
+    hand_eval_init();
+
+    equity_job_t job;
+    memset(&job, 0, sizeof(job));
+    job.request = request;
+    if (remove_known_cards(&job) < 0) return -1;
+
+    job.missing = MAX_COMMUNITY_CARDS - request->num_board;
+    if (job.deck_size < job.missing) return -1;
+
+    long exact_limit = request->exact_limit > 0 ? request->exact_limit : EQUITY_EXACT_LIMIT;
+    job.exact = choose(job.deck_size, job.missing) <= exact_limit;
+
+    if (job.exact) {
+        job.num_units = job.missing == 0 ? 1 : job.deck_size;
+    } else {
+        job.iterations = request->iterations > 0 ? request->iterations : EQUITY_DEFAULT_ITERATIONS;
+        // with only a time limit keep sampling until it runs out
+        if (request->iterations <= 0 && request->time_limit > 0) job.iterations = (long)1 << 50;
+        job.num_units = (job.iterations + CHUNK_BOARDS - 1) / CHUNK_BOARDS;
+        if (request->time_limit > 0) job.deadline = now_sec() + request->time_limit;
+    }
+
+    int num_threads = request->num_threads > 0 ? request->num_threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads < 1) num_threads = 1;
+    if (num_threads > job.num_units) num_threads = job.num_units;
+
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_t threads[num_threads];
+    int started = 0;
+    // the threads that did start share out every unit between them
+    for (int t = 0; t < num_threads; t++) {
+        if (pthread_create(&threads[started], NULL, equity_thread, &job) == 0) started++;
+    }
+    for (int t = 0; t < started; t++) pthread_join(threads[t], NULL);
+    pthread_mutex_destroy(&job.lock);
+    if (started == 0) {
+        perror("[Server] pthread_create() failed.");
+        return -1;
+    }
+
+    memset(result, 0, sizeof(*result));
+    result->boards = job.total.boards;
+    result->exact = job.exact;
+    if (job.total.boards == 0) return 0;
+
+    for (int i = 0; i < request->num_players; i++) {
+        result->equity[i] = (double)job.total.shares[i] / ((double)job.total.boards * POT_SHARES);
+        result->win[i] = (double)job.total.wins[i] / job.total.boards;
+        result->tie[i] = (double)job.total.ties[i] / job.total.boards;
+    }
+    return 0;
+}
+
+// ---------------------------- Equity thread ---------------------------- //
+
+typedef struct {
+    equity_request_t request;
+    card_t dead_cards[DECK_SIZE];   // the request's dead cards, which the caller may reuse right away
+    equity_done_t done;
+    void *data;
+} equity_queued_t;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t thread;
+    int running;
+    int stop;
+    equity_queued_t queue[EQUITY_QUEUE_SIZE];
+    int head;                       // next request to work out
+    int count;
+} service = { .lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER };
+
+static void *equity_service_main(void *arg) {
+    // only the cores the workers leave idle, a table never waits for an equity it prints
+    struct sched_param param = { 0 };
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+
+    pthread_mutex_lock(&service.lock);
+    for (;;) {
+        while (service.count == 0 && !service.stop) pthread_cond_wait(&service.wake, &service.lock);
+        if (service.count == 0) break;
+        equity_queued_t job = service.queue[service.head];
+        service.head = (service.head + 1) % EQUITY_QUEUE_SIZE;
+        service.count--;
+        pthread_mutex_unlock(&service.lock);
+
+        job.request.dead_cards = job.dead_cards;
+        equity_result_t result;
+        int valid = equity_calculate(&job.request, &result) == 0;
+        job.done(&job.request, valid ? &result : NULL, job.data);
+
+        pthread_mutex_lock(&service.lock);
+    }
+    pthread_mutex_unlock(&service.lock);
+    return NULL;
+}
+
+int equity_service_start(void) {
+    pthread_mutex_lock(&service.lock);
+    int ok = service.running || pthread_create(&service.thread, NULL, equity_service_main, NULL) == 0;
+    if (ok) service.running = 1;
+    pthread_mutex_unlock(&service.lock);
+    return ok ? 0 : -1;
+}
+
+void equity_service_stop(void) {
+    pthread_mutex_lock(&service.lock);
+    int running = service.running;
+    service.stop = 1;
+    pthread_cond_signal(&service.wake);
+    pthread_mutex_unlock(&service.lock);
+    if (running) pthread_join(service.thread, NULL);
+
+    pthread_mutex_lock(&service.lock);
+    service.running = 0;
+    service.stop = 0;
+    pthread_mutex_unlock(&service.lock);
+}
+
+int equity_submit(const equity_request_t *request, equity_done_t done, void *data) {
+    if (request->num_dead < 0 || request->num_dead > DECK_SIZE) return -1;
+    pthread_mutex_lock(&service.lock);
+    if (!service.running || service.stop || service.count == EQUITY_QUEUE_SIZE) {
+        pthread_mutex_unlock(&service.lock);
+        return -1;
+    }
+    equity_queued_t *job = &service.queue[(service.head + service.count) % EQUITY_QUEUE_SIZE];
+    job->request = *request;
+    if (request->num_dead > 0) memcpy(job->dead_cards, request->dead_cards, request->num_dead * sizeof(card_t));
+    job->done = done;
+    job->data = data;
+    service.count++;
+    pthread_cond_signal(&service.wake);
+    pthread_mutex_unlock(&service.lock);
+    return 0;
+}
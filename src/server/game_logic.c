@@ -8,6 +8,8 @@
 #include "poker_client.h"
 #include "client_action_handler.h"
 #include "game_logic.h"
+#include "hand_eval.h"
+#include "equity.h"
 
 //Feel free to add your own code. I stripped out most of our solution functions but I left some "breadcrumbs" for anyone lost
 void init_deck(card_t deck[DECK_SIZE], int seed){ //DO NOT TOUCH THIS FUNCTION
@@ -32,15 +34,21 @@ void shuffle_deck(card_t deck[DECK_SIZE]){ //DO NOT TOUCH THIS FUNCTION
 //You dont need to use this if you dont want, but we did.
 void init_game_state(game_state_t *game, int starting_stack, int random_seed){
     memset(game, 0, sizeof(game_state_t));
-    init_deck(game->deck, random_seed);
+    hand_eval_init(); // Build the showdown lookup tables once, before the first hand
+    deck_init(&game->deck, RNG_LEGACY, (uint32_t)random_seed); // Deals exactly what init_deck + shuffle_deck would
     for (int i = 0; i < MAX_PLAYERS; i++) {
         game->player_stacks[i] = starting_stack;
     }
 }
 
+// Reseeds the table's own generator, e.g. with rng_table_seed(master_seed, table) for one of many tables
+void seed_game_rng(game_state_t *game, rng_mode_t mode, uint64_t seed) {
+    deck_seed(&game->deck, mode, seed);
+}
+
 // Reset Game
 void reset_game_state(game_state_t *game) {
-    shuffle_deck(game->deck);
+    deck_reset(&game->deck); // Cards are shuffled in as they are dealt, from this table's own generator
     
     // Resetting cards that the players have
     for (int i = 0; i < MAX_PLAYERS; i++){
@@ -53,9 +61,7 @@ void reset_game_state(game_state_t *game) {
     for (int i = 0; i < MAX_COMMUNITY_CARDS; i++){
         game->community_cards[i] = NOCARD;
     }
-
-    // Resetting Next Card to be 0
-    game->next_card = 0;
+    hand_board_reset(&game->board);
 
     // Resetting bets
     for (int i = 0; i < MAX_PLAYERS; i++){
@@ -118,8 +124,8 @@ int server_ready(game_state_t *game) {
 void server_deal(game_state_t *game) {
     for (int i = 0; i < MAX_PLAYERS; i++) {
         if (game->player_status[i] == PLAYER_ACTIVE) {
-            game->player_hands[i][0] = game->deck[game->next_card++];
-            game->player_hands[i][1] = game->deck[game->next_card++];
+            game->player_hands[i][0] = deck_draw(&game->deck);
+            game->player_hands[i][1] = deck_draw(&game->deck);
         }
     }
 }
@@ -129,20 +135,25 @@ void server_community(game_state_t *game) {
     round_stage_t round_stage = game->round_stage;
     if (round_stage == ROUND_FLOP) {
         // We are now IN the FLOP stage, deal the 3 flop cards
-        if (game->next_card + 3 <= DECK_SIZE) {
-            game->community_cards[0] = game->deck[game->next_card++];
-            game->community_cards[1] = game->deck[game->next_card++];
-            game->community_cards[2] = game->deck[game->next_card++];
+        if (deck_remaining(&game->deck) >= 3) {
+            game->community_cards[0] = deck_draw(&game->deck);
+            game->community_cards[1] = deck_draw(&game->deck);
+            game->community_cards[2] = deck_draw(&game->deck);
+            hand_board_add(&game->board, game->community_cards[0]);
+            hand_board_add(&game->board, game->community_cards[1]);
+            hand_board_add(&game->board, game->community_cards[2]);
         } else { printf("Out of Deck Cards"); }
     } else if (round_stage == ROUND_TURN) {
         // We are now IN the TURN stage, deal the 1 turn card
-         if (game->next_card + 1 <= DECK_SIZE) {
-            game->community_cards[3] = game->deck[game->next_card++];
+         if (deck_remaining(&game->deck) >= 1) {
+            game->community_cards[3] = deck_draw(&game->deck);
+            hand_board_add(&game->board, game->community_cards[3]);
          } else { printf("Out of Deck Cards"); }
     } else if (round_stage == ROUND_RIVER) {
         // We are now IN the RIVER stage, deal the 1 river card
-         if (game->next_card + 1 <= DECK_SIZE) {
-            game->community_cards[4] = game->deck[game->next_card++];
+         if (deck_remaining(&game->deck) >= 1) {
+            game->community_cards[4] = deck_draw(&game->deck);
+            hand_board_add(&game->board, game->community_cards[4]);
          } else { printf("Out of Deck Cards"); }
     }
 }
@@ -338,17 +349,8 @@ int calculate_5card_value(card_t current_hand[]){
     }
 }
 
-// Function to evaluate the value of each player's hand
-int evaluate_hand(game_state_t *game, player_id_t pid) {
-    card_t all_cards[7];
-
-    all_cards[0] = game->player_hands[pid][0];
-    all_cards[1] = game->player_hands[pid][1];
-
-    for (int i = 0; i < 5; ++i) {
-        all_cards[2 + i] = game->community_cards[i];
-    }
-
+// Scores all 21 five card combinations of 7 cards, kept as the reference for the lookup tables
+int evaluate_hand_combinations(card_t all_cards[7]) {
     sort_cards(all_cards);
 
     card_t current_hand[5] = {0};
@@ -381,90 +383,206 @@ int evaluate_hand(game_state_t *game, player_id_t pid) {
     return max_value;
 }
 
+// Function to evaluate the value of each player's hand
+int evaluate_hand(game_state_t *game, player_id_t pid) {
+    card_t all_cards[7];
+
+    all_cards[0] = game->player_hands[pid][0];
+    all_cards[1] = game->player_hands[pid][1];
+
+    for (int i = 0; i < 5; ++i) {
+        all_cards[2 + i] = game->community_cards[i];
+    }
+
+    // Without the table file (see make tables) take the calculate_5card_value route instead
+    if (!hand_eval_tables_loaded()) return evaluate_hand_combinations(all_cards);
+
+    return hand_eval7(all_cards); // Same scores as evaluate_hand_combinations, straight from the tables
+}
+
+// Best hand the player has made with the board dealt so far, cheap enough to ask every street
+int current_best_hand(game_state_t *game, player_id_t pid) {
+    return hand_board_score(&game->board, game->player_hands[pid]);
+}
+
+// Prints the equity log_allin_equity asked for, on the equity thread
+static void print_allin_equity(const equity_request_t *request, const equity_result_t *result, void *data) {
+    player_id_t *seats = data;
+    if (result) {
+        // one printf, so the line does not interleave with what the workers print meanwhile
+        char line[256];
+        int len = snprintf(line, sizeof(line), "[Server] All-in equity (%s, %ld boards):", result->exact ? "exact" : "sampled", result->boards);
+        for (int i = 0; i < request->num_players && len < (int)sizeof(line); i++) {
+            len += snprintf(line + len, sizeof(line) - len, " Player %d %.2f%%", seats[i], 100 * result->equity[i]);
+        }
+        printf("%s\n", line);
+    }
+    free(seats);
+}
+
+// Once nobody can bet any more before the river, has every player's chance of winning printed.
+// the equity thread works it out on a single core, so the tables of this worker do not wait for it
+void log_allin_equity(game_state_t *game) {
+    int num_board = 0;
+    if (game->round_stage == ROUND_FLOP) num_board = 3;
+    else if (game->round_stage == ROUND_TURN) num_board = 4;
+    else if (game->round_stage != ROUND_PREFLOP) return;
+
+    equity_request_t request;
+    memset(&request, 0, sizeof(request));
+    player_id_t seats[MAX_PLAYERS];
+    int activ = 0;
+
+    for (player_id_t i = 0; i < MAX_PLAYERS; i++) {
+        if (game->player_status[i] != PLAYER_ACTIVE && game->player_status[i] != PLAYER_ALLIN) continue;
+        if (game->player_status[i] == PLAYER_ACTIVE) activ++;
+        seats[request.num_players] = i;
+        request.hole_cards[request.num_players][0] = game->player_hands[i][0];
+        request.hole_cards[request.num_players][1] = game->player_hands[i][1];
+        request.num_players++;
+    }
+    if (request.num_players < 2 || activ > 1) return; // Somebody can still bet, the hand is not all-in yet
+
+    memcpy(request.board, game->community_cards, num_board * sizeof(card_t));
+    request.num_board = num_board;
+    request.seed = EQUITY_SERVER_SEED;
+    request.num_threads = 1;
+
+    player_id_t *printed = malloc(sizeof(seats));
+    if (printed == NULL) return;
+    memcpy(printed, seats, sizeof(seats));
+    if (equity_submit(&request, print_allin_equity, printed) < 0) {
+        printf("[Server] All-in equity skipped, the equity thread is behind.\n");
+        free(printed);
+    }
+}
+
 // Returns the pid of the winner
 int find_winner(game_state_t *game) {
     player_id_t winning_player_id = -1;
     int highest_hand_value = -1;
-    
+
+    player_id_t seats[MAX_PLAYERS];
+    card_t hole_cards[MAX_PLAYERS][HAND_SIZE];
+    int hand_values[MAX_PLAYERS];
+    int num_hands = 0;
+
     for (player_id_t i = 0; i < MAX_PLAYERS; i++) {
         if (game->player_status[i] == PLAYER_ACTIVE || game->player_status[i] == PLAYER_ALLIN) {
+            seats[num_hands] = i;
+            hole_cards[num_hands][0] = game->player_hands[i][0];
+            hole_cards[num_hands][1] = game->player_hands[i][1];
+            num_hands++;
+        }
+    }
 
-            // Evaluate this player's best 5-card hand
-            int current_player_hand_value = evaluate_hand(game, i);
+    if (hand_eval_tables_loaded()) {
+        // The board was summed as it was dealt, so only the hole cards are left to merge in
+        hand_eval_batch_board(hand_eval_best_kernel(), &game->board, hole_cards, num_hands, hand_values);
+    } else {
+        for (int i = 0; i < num_hands; i++) hand_values[i] = evaluate_hand(game, seats[i]);
+    }
 
-            if (current_player_hand_value > highest_hand_value) {
-                highest_hand_value = current_player_hand_value;
-                winning_player_id = i; // This player is the new winner
-            }
+    for (int i = 0; i < num_hands; i++) {
+        if (hand_values[i] > highest_hand_value) {
+            highest_hand_value = hand_values[i];
+            winning_player_id = seats[i]; // This player is the new winner
         }
     }
     
     return winning_player_id;
 }
 
+// Builds the INFO once for every seat and patches in each seat's hole cards
 void broadcast_info(game_state_t *game) {
     server_packet_t server_packet;
+    int built = 0;
     for (int i = 0; i < MAX_PLAYERS; i++) {  
         if (game->player_status[i] == PLAYER_LEFT) continue;
-        build_info_packet(game,i,&server_packet); // Builds an INFO packet for a given PID and stores it inside server packet
-        send(game->sockets[i], &server_packet, sizeof(server_packet_t), 0); 
+        if (!built) {
+            memset(&server_packet, 0, sizeof(server_packet_t));
+            build_info_packet(game,i,&server_packet); // Builds an INFO packet for a given PID and stores it inside server packet
+            built = 1;
+        } else {
+            patch_info_packet(game,i,&server_packet); // Everything but the hole cards is the same for every seat
+        }
+        send_server_packet(game, i, &server_packet);
     }
 }
 
+// Every seat gets the same END, so it is built once
 void broadcast_end(game_state_t *game, int pid) {
     server_packet_t server_packet;
+    memset(&server_packet, 0, sizeof(server_packet_t));
+    build_end_packet(game,pid,&server_packet); // Builds an END packet for a given PID and stores it inside server packet
     for (int i = 0; i < MAX_PLAYERS; i++) {  
         if (game->player_status[i] == PLAYER_LEFT) continue;
-        build_end_packet(game,pid,&server_packet); // Builds an END packet for a given PID and stores it inside server packet
-        ssize_t bytes_sent = send(game->sockets[i], &server_packet, sizeof(server_packet_t), 0); // Sends the END packet
+        send_server_packet(game, i, &server_packet); // Sends the END packet
     }
 }
 
-// Does betting until everyone had a chance to RAISE
-int do_betting(game_state_t *game, client_packet_t *received_packet){
-    int activ = 0;
-    int all = 0;
+// Sends a player a packet through the table's reactor, which may batch it with the rest of the table's packets
+ssize_t send_server_packet(game_state_t *game, player_id_t pid, const server_packet_t *pkt) {
+    if (game->send_packet) return game->send_packet(game, pid, pkt);
+    return send(game->sockets[pid], pkt, sizeof(server_packet_t), 0);
+}
 
-    for (int i = 0; i < MAX_PLAYERS; i++) {  
-        if (game->player_status[i] == PLAYER_ACTIVE) activ++;
-        if (game->player_status[i] == PLAYER_ALLIN ) all++;
+// Starts the betting on a street with game->current_player to act first.
+// BETTING_OPEN while somebody still has to act, BETTING_DONE if nobody can
+int betting_start(game_state_t *game) {
+    betting_t *bet = &game->betting;
+    bet->active = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (game->player_status[i] == PLAYER_ACTIVE) bet->active++;
     }
 
-    int activ_all = activ + all;
-    int activ_all_temp = activ;
-    int activ_all_temp2 = activ;
+    bet->to_act = bet->active;
+    bet->turn = 0;
+    return bet->turn < bet->to_act ? BETTING_OPEN : BETTING_DONE;
+}
 
-    // Expect betting response after INFO being sent out
-    for (int i = 0; i < activ_all_temp; i++) { // Continue to go around betting until everyone has either folded or matched the current bet
-        int cur_player = game->current_player;
-        
-        read(game->sockets[cur_player], received_packet, sizeof(client_packet_t)); //  Read the Packet Sent 
-        
-        server_packet_t server_pack;
-        
-        int chk = handle_client_action(game,cur_player,received_packet,&server_pack);
+// Handles the action of the player whose turn it is, one pass of the old do_betting loop.
+// received is 0 for a packet, -1 if they disconnected and RECV_TIMEOUT if they ran out of time.
+// BETTING_OPEN while somebody still has to act, BETTING_DONE once everyone had a chance to RAISE,
+// BETTING_FOLDED if all but one folded
+int betting_act(game_state_t *game, client_packet_t *received_packet, int received){
+    betting_t *bet = &game->betting;
+    int cur_player = game->current_player;
+
+    if (received == RECV_TIMEOUT) {
+        received_packet->packet_type = CHECK; // A player who ran out of time checks if they can, and folds otherwise
+    } else if (received < 0) {
+        received_packet->packet_type = FOLD; // A player who disconnected on their turn folds
+    }
 
-        send(game->sockets[cur_player],&server_pack, sizeof(server_packet_t), 0);
+    server_packet_t server_pack;
 
-        if (received_packet->packet_type == FOLD) { // Treat FOLD separately because it will pass no matter what in this scenario
-            activ--; // One active player folded
-            activ_all_temp2--;
+    int chk = handle_client_action(game,cur_player,received_packet,&server_pack);
+    if (chk == -1 && received == RECV_TIMEOUT) {
+        received_packet->packet_type = FOLD;
+        chk = handle_client_action(game,cur_player,received_packet,&server_pack);
+    }
+    server_pack.reply.seq = received_packet->seq; // 0 for an action taken for the player
 
-            if (activ < 2){ // If all except 1 folded, jump to end state
-                return 1; // return 1 if isEnd
-            }
-        } 
+    send_server_packet(game, cur_player, &server_pack);
 
-        if (chk == 0){ // IF ACK
-            if (received_packet->packet_type == RAISE) {i = 0;activ_all_temp=activ_all_temp2;} // Reset i if successfully raised
-        
-            if ((i + 1) != activ_all_temp) find_next_player(game,0);
-            else find_next_player(game,1);
+    if (received_packet->packet_type == FOLD) { // Treat FOLD separately because it will pass no matter what in this scenario
+        bet->active--; // One active player folded
 
-            if ((i + 1) != activ_all_temp) broadcast_info(game); // Only broadcast if it is NOT the last iter.
-        } else { // IF NACK
-            i -= 1;        
+        if (bet->active < 2){ // If all except 1 folded, jump to end state
+            return BETTING_FOLDED;
         }
     }
-    return 0; // Betting successful
-}
\ No newline at end of file
+
+    if (chk == 0){ // IF ACK
+        if (received_packet->packet_type == RAISE) {bet->turn = 0;bet->to_act=bet->active;} // Reset the turns if successfully raised
+
+        if ((bet->turn + 1) != bet->to_act) find_next_player(game,0);
+        else find_next_player(game,1);
+
+        if ((bet->turn + 1) != bet->to_act) broadcast_info(game); // Only broadcast if it is NOT the last turn.
+        bet->turn++;
+    } // IF NACK the same player acts again
+
+    return bet->turn < bet->to_act ? BETTING_OPEN : BETTING_DONE;
+}
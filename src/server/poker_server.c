@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <signal.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
@@ -8,10 +10,13 @@
 #include "poker_client.h"
 #include "client_action_handler.h"
 #include "game_logic.h"
+#include "reactor.h"
+#include "table.h"
+#include "acceptor.h"
 
-#define BASE_PORT 2201
-#define NUM_PORTS 6
 #define BUFFER_SIZE 1024
+// acceptor threads sharing the first port, past which SO_REUSEPORT stops spreading connections usefully
+#define MAX_ACCEPTORS 64
 
 int calculate_5card_value(card_t current_hand[]);
 int set_card_tie(int final_points, int ranks[]);
@@ -21,7 +26,6 @@ int get_suit(card_t card);
 int get_card_rank(card_t card);
 void find_next_player(game_state_t *game, int flag);
 void broadcast_end(game_state_t *game, int pid);
-int do_betting(game_state_t *game, client_packet_t *received_packet);
 void broadcast_info(game_state_t *game);
 
 typedef struct {
@@ -29,209 +33,85 @@ typedef struct {
     struct sockaddr_in address;
 } player_t;
 
-game_state_t game; //global variable to store our game state info (this is a huge hint for you)
+table_pool_t pool; // every table the server runs, and the worker threads that run them
+acceptor_t acceptors[MAX_ACCEPTORS]; // own the listening sockets, the workers' reactors own the players' sockets
 
 int main(int argc, char **argv) {
-    int server_fds[NUM_PORTS] = {0};
-    int opt = 1;
-    struct sockaddr_in server_address;
-    player_t players[MAX_PLAYERS];
-    socklen_t addrlen = sizeof(struct sockaddr_in);
-
-    int rand_seed = argc == 2 ? atoi(argv[1]) : 0;
-    init_game_state(&game, 100, rand_seed);
-
-    //Setup the server infrastructre and accept the 6 players on ports 2201, 2202, 2203, 2204, 2205, 2206
-    for (int i = 0; i < NUM_PORTS; i++){
-        if ((server_fds[i] = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-            perror("socket failed");
+    // usage: poker_server [-t tables] [-w workers] [-a acceptors] [-n] [-d deadline_ms] [-m min_players] [-c clock_ms]
+    // [-b epoll|io_uring] [seed] [legacy|xoshiro|chacha], legacy deals the same cards rand() always did and chacha
+    // ignores the seed and deals unpredictable cards. the server stops after playing the given number of tables, 1 by default and 0 to keep
+    // seating new tables forever, and runs them on one worker thread per core unless told otherwise. players join on
+    // the first port, through as many acceptor threads as asked for, and on the seat ports after it unless -n is
+    // given. a table starts once every seat is taken, or with min_players, 2 by default, deadline_ms after it opened.
+    // a player who takes longer than clock_ms to act checks, or folds if they cannot, one who takes longer to say READY
+    // leaves the table, and by default they have all the time.
+    // the sockets are served through epoll unless io_uring is asked for and the kernel has it
+    table_config_t config = { .starting_stack = 100, .seed = 0, .rng_mode = RNG_LEGACY, .max_tables = 1, .num_workers = 0,
+                              .min_players = 2, .join_deadline_ms = 0, .turn_timeout_ms = 0,
+                              .backend = REACTOR_EPOLL };
+    int num_acceptors = 1;
+    int seat_ports = 1;
+    int flag;
+    while ((flag = getopt(argc, argv, "t:w:a:nd:m:c:b:")) != -1) {
+        if (flag == 't') config.max_tables = atoi(optarg);
+        else if (flag == 'w') config.num_workers = atoi(optarg);
+        else if (flag == 'a') num_acceptors = atoi(optarg);
+        else if (flag == 'n') seat_ports = 0;
+        else if (flag == 'd') config.join_deadline_ms = atoi(optarg);
+        else if (flag == 'm') config.min_players = atoi(optarg);
+        else if (flag == 'c') config.turn_timeout_ms = atoi(optarg);
+        else if (flag == 'b' && strcmp(optarg, "io_uring") == 0) config.backend = REACTOR_IO_URING;
+        else if (flag == 'b' && strcmp(optarg, "epoll") == 0) config.backend = REACTOR_EPOLL;
+        else {
+            fprintf(stderr, "usage: %s [-t tables] [-w workers] [-a acceptors] [-n] [-d deadline_ms] [-m min_players] [-c clock_ms] [-b epoll|io_uring] [seed] [legacy|xoshiro|chacha]\n", argv[0]);
             exit(EXIT_FAILURE);
         }
-    
-        // Set socket options
-        if (setsockopt(server_fds[i], SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
-            perror("setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))");
-            exit(EXIT_FAILURE);
-        }
-    
-        // Bind socket to port
-        server_address.sin_family = AF_INET;
-        server_address.sin_addr.s_addr = INADDR_ANY;
-        server_address.sin_port = htons(BASE_PORT+i);
-        if (bind(server_fds[i], (struct sockaddr *)&server_address, sizeof(server_address)) < 0) {
-            perror("[Server] bind() failed.");
-            exit(EXIT_FAILURE);
-        }
-    
-        // Listen for incoming connections
-        if (listen(server_fds[i], 0) < 0) {
-            perror("[Server] listen() failed.");
-            exit(EXIT_FAILURE);
-        }
-    
-        printf("[Server] Running on port %d\n", BASE_PORT+i);
     }
-
-
-    // Do Accept Separately after listening to all 6 ports and store the sockets:
-    for (int i = 0; i < NUM_PORTS; i++){
-        if ((game.sockets[i] = accept(server_fds[i], (struct sockaddr *)&server_address, (socklen_t *)&addrlen)) == 0) {
-            printf("[Server] accept() failed.\n");
-            exit(EXIT_FAILURE);
-        } else {
-            printf("[Server] accept() successful at port %d \n",game.sockets[i]);
-        }
+    if (num_acceptors < 1) num_acceptors = 1;
+    if (num_acceptors > MAX_ACCEPTORS) num_acceptors = MAX_ACCEPTORS;
+    if (config.min_players < 2) config.min_players = 2; // a hand needs two players
+    if (config.min_players > MAX_PLAYERS) config.min_players = MAX_PLAYERS;
+    if (optind < argc) config.seed = atoi(argv[optind]);
+    if (optind + 1 < argc && strcmp(argv[optind + 1], "xoshiro") == 0) config.rng_mode = RNG_XOSHIRO;
+    if (optind + 1 < argc && strcmp(argv[optind + 1], "chacha") == 0) config.rng_mode = RNG_CHACHA;
+
+    if (config.backend == REACTOR_IO_URING && !reactor_backend_available(REACTOR_IO_URING)) {
+        printf("[Server] io_uring is not available, using epoll.\n");
+        config.backend = REACTOR_EPOLL;
     }
+    if (config.backend == REACTOR_IO_URING) printf("[Server] Serving the sockets through io_uring.\n");
 
+    signal(SIGPIPE, SIG_IGN); // a client that went away must not take the server down with it
+    hand_eval_init();
+    if (hand_eval_tables_loaded()) printf("[Server] Mapped hand evaluator tables.\n");
+    else printf("[Server] No hand evaluator tables at %s, run make tables. Using the slow evaluator.\n", HAND_EVAL_TABLES_PATH);
 
-    //JOIN STATE
-    game.round_stage = ROUND_JOIN;
-    // READ THE JOINS
-    client_packet_t received_packet; // Declare a variable of the correct struct type
-    memset(&received_packet, 0, sizeof(client_packet_t));
-
-    for (int i = 0; i < MAX_PLAYERS; i++) {    
-        int nbytes = read(game.sockets[i], &received_packet, sizeof(client_packet_t)); // Read JOIN into the struct
-        // /workspaces/cse220_hw5/build/tui.client
-        if (received_packet.packet_type == JOIN) {
-            printf("[Server] Player %d sent JOIN packet successfully.\n", i);
-        }
+    //Setup the server infrastructre, every acceptor listens on port 2201 and the first one on ports 2202 to 2206 too
+    for (int i = 0; i < num_acceptors; i++) {
+        if (acceptor_init(&acceptors[i], &pool, i, i == 0 && seat_ports, config.backend) < 0) exit(EXIT_FAILURE);
     }
+    if (table_pool_init(&pool, &config, acceptors[0].reactor) < 0) exit(EXIT_FAILURE);
+    for (int i = 1; i < num_acceptors; i++) {
+        if (acceptor_start(&acceptors[i]) < 0) exit(EXIT_FAILURE);
+    }
+    if (num_acceptors > 1) printf("[Server] Accepting players on %d threads.\n", num_acceptors);
 
-    int isEnd;
-    game.dealer_player = -1;
-    while (1) {
-        isEnd = 0;
-        // INIT STATE
-        // READY
-        game.round_stage = ROUND_INIT;
-
-        // Read all the READY / LEAVE
-        for (int i = 0; i < MAX_PLAYERS; i++) {    
-            if (game.player_status[i] == PLAYER_LEFT){
-                continue;
-            }
-
-            int nbytes = read(game.sockets[i], &received_packet, sizeof(client_packet_t));
-            
-            if (received_packet.packet_type == READY) {
-                printf("[Server] Player %d sent READY packet successfully.\n", i);
-                // If READY fails because CLIENT is out of money, do nothing and mark client as LEFT (Strict)
-                if (handle_client_action(&game,i,&received_packet,NULL) == -1){ // Incase READY failed because CLIENT is out of money, they will automatically get booted out.
-                    printf("[Server] Player %d sent READY packet successfully but no stacks so logging them out.\n", i);
-                    close(server_fds[i]);
-                    close(game.sockets[i]);
-                }
-            } else if (received_packet.packet_type == LEAVE) { 
-                printf("[Server] Player %d sent LEAVE packet successfully.\n", i);
-                handle_client_action(&game,i,&received_packet,NULL);
-                close(server_fds[i]);
-                close(game.sockets[i]);
-            }
-        }
-
-        int chk_ready = server_ready(&game);
-        
-        if (chk_ready == 0){ // Less than 2 player ready, HALT
-            for (int i = 0; i < MAX_PLAYERS; i++){
-                if (game.player_status[i] != PLAYER_LEFT) {
-                    server_packet_t server_packet;
-                    server_packet.packet_type = HALT;
-                    send(game.sockets[i], &server_packet, sizeof(server_packet_t), 0); // Sends HALT                   
-                }
-            }
-            break;
-        } else if (chk_ready == -1){ // All Players Left, just break
-            break;
-        }
-
-        reset_game_state(&game); // Reset the game server, assign the cur_player based on dealer
-
-        // PREFLOP STATE
-        // DEAL TO PLAYERS
-        // PREFLOP BETTING
-        printf("[Server] ENTERING PREFLOP STAGE");
-        game.round_stage = ROUND_PREFLOP;
-        server_deal(&game); // Deal Cards to all ACTIVE players
-        broadcast_info(&game); // Send INFO packet to all the ACTIVE players
-        
-        isEnd = do_betting(&game, &received_packet);
-        
-        for (int i = 0; i < MAX_PLAYERS; i++) game.current_bets[i] = 0 ;
-        game.highest_bet = 0;
-
-        if (isEnd == 0){
-            printf("[Server] ENTERING FLOP STAGE");
-            // FLOP STATE
-            // PLACE FLOP CARDS
-            // FLOP BETTING
-            game.round_stage = ROUND_FLOP;
-            server_community(&game); // Adds 3 cards to community
-            broadcast_info(&game); // Send INFO packet to all the ACTIVE players with new points
-            
-            isEnd = do_betting(&game, &received_packet);
-
-            for (int i = 0; i < MAX_PLAYERS; i++) game.current_bets[i] = 0 ;
-            game.highest_bet = 0;
-        }
-
-        if (isEnd == 0){
-            printf("[Server] ENTERING TURN STAGE");
-            // TURN STATE
-            game.round_stage = ROUND_TURN;
-            server_community(&game); // Adds +1 cards to community
-            broadcast_info(&game); // Send INFO packet to all the ACTIVE players with new points
-            
-            isEnd = do_betting(&game, &received_packet);  
-            
-            for (int i = 0; i < MAX_PLAYERS; i++) game.current_bets[i] = 0 ;
-            game.highest_bet = 0;
-        }
-
-        if (isEnd == 0){
-            printf("[Server] ENTERING RIVER STAGE");
-            // RIVER STATE
-            game.round_stage = ROUND_RIVER;
-            server_community(&game); // Adds +1 cards to community
-            broadcast_info(&game); // Send INFO packet to all the ACTIVE players with new points
-            
-            isEnd = do_betting(&game, &received_packet);
-        }
-        
-        if (isEnd == 0){
-            printf("[Server] ENTERING SHOWDOWN STAGE");
-            // SHOWDOWN STATE
-            // ROUND_SHOWDOWN
-            game.round_stage = ROUND_SHOWDOWN;
-        }
-
-        // END State :
-        printf("[Server] ENTERING END STAGE");
-        if (isEnd == 1){ // This means only one player is left who is NOT folded, find him and award him everything.
-            for (int i = 0; i < MAX_PLAYERS; i++){
-                if (game.player_status[i] != PLAYER_FOLDED && game.player_status[i] != PLAYER_LEFT) {
-                    
-                    game.player_stacks[i] += game.pot_size; // Award the stacks to the remaining player
-                    broadcast_end(&game, i);                    
-                }
-            }
-        } else {
-            int winn = find_winner(&game); // Find Winner
-            
-            game.player_stacks[winn] += game.pot_size; // Award the stacks to the remaining player
-            broadcast_end(&game, winn);
-        }
+    // This thread runs the first acceptor and starts the tables whose deadline passed, the workers play the tables
+    // until the last one finishes and wakes it up
+    while (!table_pool_done(&pool)) {
+        if (reactor_poll(acceptors[0].reactor, table_pool_start_due(&pool)) < 0) break;
     }
+    for (int i = 1; i < num_acceptors; i++) {
+        acceptor_stop(&acceptors[i]);
+    }
+    table_pool_destroy(&pool);
 
     printf("[Server] Shutting down.\n");
 
-    // Close all fds (you're welcome)
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        close(server_fds[i]);
-        if (game.player_status[i] != PLAYER_LEFT) {
-            close(game.sockets[i]);
-        }
+    // Close all fds (you're welcome), the tables closed their players' sockets already
+    for (int i = 0; i < num_acceptors; i++) {
+        acceptor_destroy(&acceptors[i]);
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#include "reactor.h"
+#include "reactor_backend.h"
+#include "wire.h"
+
+// ---------------------------- Packet Queues ---------------------------- //
+
+int packet_queue_push(packet_queue_t *queue, const client_packet_t *pkt) {
+    unsigned tail = queue->tail;
+    if (tail - __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) == PACKET_QUEUE_SIZE) return -1;
+    queue->packets[tail % PACKET_QUEUE_SIZE] = *pkt;
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int packet_queue_pop(packet_queue_t *queue, client_packet_t *pkt) {
+    unsigned head = queue->head;
+    if (head == __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE)) return -1;
+    *pkt = queue->packets[head % PACKET_QUEUE_SIZE];
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int packet_queue_empty(const packet_queue_t *queue) {
+    return __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) == __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+}
+
+void packet_queue_close(packet_queue_t *queue) {
+    __atomic_store_n(&queue->closed, 1, __ATOMIC_RELEASE);
+}
+
+int packet_queue_closed(const packet_queue_t *queue) {
+    return __atomic_load_n(&queue->closed, __ATOMIC_ACQUIRE);
+}
+
+// ---------------------------- Reactor ---------------------------- //
+
+int reactor_backend_available(reactor_backend_t backend) {
+    return backend == REACTOR_EPOLL || reactor_uring_available();
+}
+
+reactor_t *reactor_create(reactor_backend_t backend, reactor_accept_fn on_accept, reactor_packet_fn on_packet,
+                          reactor_close_fn on_close) {
+    reactor_t *reactor = calloc(1, sizeof(reactor_t));
+    if (!reactor) return NULL;
+
+    reactor->ops = backend == REACTOR_IO_URING ? &reactor_uring_ops : &reactor_epoll_ops;
+    reactor->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (reactor->wakeup_fd < 0) {
+        perror("[Server] eventfd() failed.");
+        free(reactor);
+        return NULL;
+    }
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&reactor->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    reactor->on_accept = on_accept;
+    reactor->on_packet = on_packet;
+    reactor->on_close = on_close;
+
+    if (reactor->ops->init(reactor) < 0) {
+        close(reactor->wakeup_fd);
+        pthread_mutex_destroy(&reactor->lock);
+        free(reactor);
+        return NULL;
+    }
+    return reactor;
+}
+
+void reactor_destroy(reactor_t *reactor) {
+    if (!reactor) return;
+    reactor->ops->destroy(reactor);
+    close(reactor->wakeup_fd);
+    pthread_mutex_destroy(&reactor->lock);
+    free(reactor->conns);
+    free(reactor);
+}
+
+// Starts watching fd for input
+static int watch(reactor_t *reactor, int fd, int listening, int once, void *data) {
+    if (fd < 0) return -1;
+
+    // grow the table so it can be indexed by any fd the process hands out
+    if (fd >= reactor->num_conns) {
+        int num_conns = reactor->num_conns ? reactor->num_conns : 64;
+        while (num_conns <= fd) num_conns *= 2;
+        conn_t *conns = realloc(reactor->conns, num_conns * sizeof(conn_t));
+        if (!conns) return -1;
+        memset(conns + reactor->num_conns, 0, (num_conns - reactor->num_conns) * sizeof(conn_t));
+        reactor->conns = conns;
+        reactor->num_conns = num_conns;
+    }
+
+    conn_t *conn = &reactor->conns[fd];
+    uint32_t gen = conn->gen + 1;
+    memset(conn, 0, sizeof(conn_t));
+    conn->gen = gen;
+    conn->listening = listening;
+    conn->once = once;
+    conn->data = data;
+    if (reactor->ops->watch(reactor, fd, conn) < 0) return -1;
+    conn->in_use = 1;
+    return 0;
+}
+
+int reactor_add(reactor_t *reactor, int fd, void *data) {
+    pthread_mutex_lock(&reactor->lock);
+    int ret = watch(reactor, fd, 0, 0, data);
+    pthread_mutex_unlock(&reactor->lock);
+    return ret;
+}
+
+int reactor_expect(reactor_t *reactor, int fd, void *data) {
+    pthread_mutex_lock(&reactor->lock);
+    int ret = watch(reactor, fd, 0, 1, data);
+    pthread_mutex_unlock(&reactor->lock);
+    return ret;
+}
+
+int reactor_listen(reactor_t *reactor, int listen_fd, void *data) {
+    pthread_mutex_lock(&reactor->lock);
+    int ret = watch(reactor, listen_fd, 1, 0, data);
+    pthread_mutex_unlock(&reactor->lock);
+    return ret;
+}
+
+conn_t *reactor_conn(reactor_t *reactor, int fd) {
+    if (fd < 0 || fd >= reactor->num_conns || !reactor->conns[fd].in_use) return NULL;
+    return &reactor->conns[fd];
+}
+
+// Stops watching fd, with the lock held
+static void unwatch(reactor_t *reactor, int fd) {
+    conn_t *conn = reactor_conn(reactor, fd);
+    if (!conn) return;
+    reactor->ops->unwatch(reactor, fd, conn);
+    conn->in_use = 0;
+}
+
+void reactor_remove(reactor_t *reactor, int fd) {
+    pthread_mutex_lock(&reactor->lock);
+    unwatch(reactor, fd);
+    pthread_mutex_unlock(&reactor->lock);
+}
+
+void reactor_set_wire(reactor_t *reactor, int fd, int wire) {
+    pthread_mutex_lock(&reactor->lock);
+    conn_t *conn = reactor_conn(reactor, fd);
+    if (conn) conn->wire = wire;
+    pthread_mutex_unlock(&reactor->lock);
+}
+
+ssize_t reactor_send(reactor_t *reactor, int fd, const void *buf, size_t len) {
+    pthread_mutex_lock(&reactor->lock);
+    ssize_t ret = reactor->ops->send(reactor, fd, reactor_conn(reactor, fd), buf, len);
+    pthread_mutex_unlock(&reactor->lock);
+    return ret;
+}
+
+void reactor_flush(reactor_t *reactor) {
+    pthread_mutex_lock(&reactor->lock);
+    reactor->ops->flush(reactor);
+    pthread_mutex_unlock(&reactor->lock);
+}
+
+void reactor_wakeup(reactor_t *reactor) {
+    uint64_t one = 1;
+    ssize_t nbytes = write(reactor->wakeup_fd, &one, sizeof(one));
+    (void)nbytes; // a full counter already wakes the reactor
+}
+
+int reactor_poll(reactor_t *reactor, int timeout_ms) {
+    return reactor->ops->poll(reactor, timeout_ms);
+}
+
+// ---------------------------- Dispatch ---------------------------- //
+
+void reactor_drain_wakeup(reactor_t *reactor) {
+    uint64_t count;
+    ssize_t nbytes = read(reactor->wakeup_fd, &count, sizeof(count));
+    (void)nbytes;
+}
+
+void reactor_accepted(reactor_t *reactor, int listen_fd, int fd) {
+    reactor->on_accept(reactor, listen_fd, fd, reactor->conns[listen_fd].data);
+}
+
+void reactor_hang_up(reactor_t *reactor, int fd) {
+    conn_t *conn = reactor_conn(reactor, fd);
+    if (!conn) return;
+    void *data = conn->data;
+    unwatch(reactor, fd);
+    if (reactor->on_close) reactor->on_close(reactor, fd, data);
+}
+
+int reactor_deliver(reactor_t *reactor, int fd, const char *buf, size_t nbytes) {
+    int dispatched = 0;
+    size_t offset = 0;
+    while (1) {
+        conn_t *conn = reactor_conn(reactor, fd);
+        if (!conn) break; // removed by the packet handler
+
+        client_packet_t pkt;
+        size_t used;
+        int decoded = wire_decode_client(conn->wire, conn->partial, conn->fill, &pkt, &used);
+        if (decoded < 0) {
+            printf("[Server] Connection at port %d sent something that is no packet, closing it.\n", fd);
+            reactor_hang_up(reactor, fd);
+            break;
+        }
+        if (decoded == 0) {
+            if (offset == nbytes) break;
+            // a raw packet is never taken past its end, so a reactor_expect socket leaves the rest of its stream
+            size_t take = sizeof(conn->partial) - conn->fill;
+            if (take > nbytes - offset) take = nbytes - offset;
+            memcpy(conn->partial + conn->fill, buf + offset, take);
+            conn->fill += take;
+            offset += take;
+            continue;
+        }
+
+        // a compact packet can be shorter than what was taken, the rest is the start of the next one
+        conn->fill -= used;
+        memmove(conn->partial, conn->partial + used, conn->fill);
+        void *data = conn->data;
+        if (conn->once) unwatch(reactor, fd);
+        reactor->on_packet(reactor, fd, &pkt, data);
+        dispatched++;
+    }
+    return dispatched;
+}
@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "reactor_backend.h"
+
+// events handled per epoll_wait
+#define MAX_EVENTS 64
+
+// What a table sent a socket since the last flush, in conn->out
+typedef struct out_buffer {
+    int fd;
+    char *bytes;
+    size_t len;
+    size_t cap;
+    int writing;                    // the socket buffer was full, EPOLLOUT is armed for the rest
+    int broken;                     // the reader fell too far behind and the socket was shut down
+    int dirty;                      // on the dirty list
+    struct out_buffer *next;        // next on the dirty list
+} out_buffer_t;
+
+// The epoll instance, in reactor->backend
+typedef struct {
+    int epoll_fd;
+    out_buffer_t *dirty;            // buffers with bytes queued since the last flush
+} epoll_backend_t;
+
+static int epoll_fd_of(reactor_t *reactor) {
+    return ((epoll_backend_t *)reactor->backend)->epoll_fd;
+}
+
+static int epoll_init(reactor_t *reactor) {
+    epoll_backend_t *backend = calloc(1, sizeof(epoll_backend_t));
+    if (!backend) return -1;
+
+    backend->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (backend->epoll_fd < 0) {
+        perror("[Server] epoll_create1() failed.");
+        free(backend);
+        return -1;
+    }
+    struct epoll_event event = { .events = EPOLLIN, .data.fd = reactor->wakeup_fd };
+    if (epoll_ctl(backend->epoll_fd, EPOLL_CTL_ADD, reactor->wakeup_fd, &event) < 0) {
+        perror("[Server] epoll_ctl() failed.");
+        close(backend->epoll_fd);
+        free(backend);
+        return -1;
+    }
+    reactor->backend = backend;
+    return 0;
+}
+
+static void free_buffer(out_buffer_t *out) {
+    free(out->bytes);
+    free(out);
+}
+
+static void epoll_destroy(reactor_t *reactor) {
+    for (int fd = 0; fd < reactor->num_conns; fd++) {
+        if (reactor->conns[fd].out) free_buffer(reactor->conns[fd].out);
+    }
+    close(epoll_fd_of(reactor));
+    free(reactor->backend);
+}
+
+static int epoll_watch(reactor_t *reactor, int fd, conn_t *conn) {
+    struct epoll_event event = { .events = EPOLLIN | EPOLLRDHUP, .data.fd = fd };
+    if (epoll_ctl(epoll_fd_of(reactor), EPOLL_CTL_ADD, fd, &event) < 0) {
+        perror("[Server] epoll_ctl() failed.");
+        return -1;
+    }
+    return 0;
+}
+
+// Sends what is queued on a socket until its buffer is full, the rest stays at the front
+static void write_buffer(out_buffer_t *out) {
+    size_t sent = 0;
+    while (sent < out->len) {
+        ssize_t nbytes = send(out->fd, out->bytes + sent, out->len - sent, MSG_NOSIGNAL);
+        if (nbytes < 0 && errno == EINTR) continue;
+        if (nbytes < 0 && errno == EAGAIN) break;
+        if (nbytes <= 0) {
+            sent = out->len; // the reader finds out the socket is gone
+            break;
+        }
+        sent += nbytes;
+    }
+    out->len -= sent;
+    memmove(out->bytes, out->bytes + sent, out->len);
+}
+
+// Writes a socket's queue and watches it for EPOLLOUT while some of it is left
+static void flush_buffer(reactor_t *reactor, out_buffer_t *out) {
+    write_buffer(out);
+    int writing = out->len > 0;
+    if (writing == out->writing) return;
+    struct epoll_event event = { .events = EPOLLIN | EPOLLRDHUP | (writing ? EPOLLOUT : 0), .data.fd = out->fd };
+    if (epoll_ctl(epoll_fd_of(reactor), EPOLL_CTL_MOD, out->fd, &event) < 0) perror("[Server] epoll_ctl() failed.");
+    else out->writing = writing;
+}
+
+static void epoll_unwatch(reactor_t *reactor, int fd, conn_t *conn) {
+    epoll_ctl(epoll_fd_of(reactor), EPOLL_CTL_DEL, fd, NULL);
+
+    // the socket is closed right after, so what the table sent it last, like a HALT, goes now if it fits
+    out_buffer_t *out = conn->out;
+    if (!out) return;
+    epoll_backend_t *backend = reactor->backend;
+    for (out_buffer_t **link = &backend->dirty; *link; link = &(*link)->next) {
+        if (*link != out) continue;
+        *link = out->next;
+        break;
+    }
+    write_buffer(out);
+    free_buffer(out);
+    conn->out = NULL;
+}
+
+static ssize_t epoll_send(reactor_t *reactor, int fd, conn_t *conn, const void *buf, size_t len) {
+    if (!conn || conn->listening) return send(fd, buf, len, MSG_NOSIGNAL);
+
+    out_buffer_t *out = conn->out;
+    if (!out) {
+        out = calloc(1, sizeof(out_buffer_t));
+        if (!out) return -1;
+        out->fd = fd;
+        conn->out = out;
+    }
+    if (out->broken) return -1;
+    if (out->len + len > MAX_BACKLOG) {
+        // a reader this far behind holds the table up for nothing, shutting the socket down hangs it up on the next poll
+        printf("[Server] Connection at port %d is not reading what it is sent, closing it.\n", fd);
+        out->broken = 1;
+        out->len = 0;
+        shutdown(fd, SHUT_RDWR);
+        return -1;
+    }
+    if (out->len + len > out->cap) {
+        size_t cap = out->cap ? out->cap : 4 * sizeof(server_packet_t);
+        while (cap < out->len + len) cap *= 2;
+        char *bytes = realloc(out->bytes, cap);
+        if (!bytes) return -1;
+        out->bytes = bytes;
+        out->cap = cap;
+    }
+    memcpy(out->bytes + out->len, buf, len);
+    out->len += len;
+
+    if (!out->dirty) {
+        epoll_backend_t *backend = reactor->backend;
+        out->dirty = 1;
+        out->next = backend->dirty;
+        backend->dirty = out;
+    }
+    return len;
+}
+
+// One send per socket for everything a table sent it while it ran, e.g. an ACK and the INFO after it.
+// a socket waiting for EPOLLOUT gets its new bytes once the older ones went out
+static void epoll_flush(reactor_t *reactor) {
+    epoll_backend_t *backend = reactor->backend;
+    while (backend->dirty) {
+        out_buffer_t *out = backend->dirty;
+        backend->dirty = out->next;
+        out->dirty = 0;
+        if (!out->writing) flush_buffer(reactor, out);
+    }
+}
+
+// Accepts a connection waiting on a listening socket
+static void accept_conn(reactor_t *reactor, int listen_fd) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+        if (errno != EINTR && errno != EAGAIN && errno != ECONNABORTED) perror("[Server] accept() failed.");
+        return;
+    }
+    reactor_accepted(reactor, listen_fd, fd);
+}
+
+// Reads what arrived on a readable socket and dispatches every packet it completes
+static int read_conn(reactor_t *reactor, int fd) {
+    char buffer[READ_SIZE];
+    conn_t *conn = reactor_conn(reactor, fd);
+    // a socket that is only expected to send one packet must keep the rest of its stream
+    size_t size = conn->once ? WIRE_RAW_CLIENT - conn->fill : sizeof(buffer);
+    ssize_t nbytes = read(fd, buffer, size);
+    if (nbytes < 0 && (errno == EINTR || errno == EAGAIN)) return 0;
+    if (nbytes <= 0) {
+        reactor_hang_up(reactor, fd);
+        return 0;
+    }
+    return reactor_deliver(reactor, fd, buffer, nbytes);
+}
+
+static int epoll_poll(reactor_t *reactor, int timeout_ms) {
+    // nothing queued waits out the poll
+    pthread_mutex_lock(&reactor->lock);
+    epoll_flush(reactor);
+    pthread_mutex_unlock(&reactor->lock);
+
+    struct epoll_event events[MAX_EVENTS];
+    int num_events = epoll_wait(epoll_fd_of(reactor), events, MAX_EVENTS, timeout_ms);
+    if (num_events < 0) {
+        if (errno == EINTR) return 0;
+        perror("[Server] epoll_wait() failed.");
+        return -1;
+    }
+
+    int dispatched = 0;
+    pthread_mutex_lock(&reactor->lock);
+    for (int i = 0; i < num_events; i++) {
+        int fd = events[i].data.fd;
+        if (fd == reactor->wakeup_fd) {
+            reactor_drain_wakeup(reactor);
+            continue;
+        }
+        conn_t *conn = reactor_conn(reactor, fd);
+        if (!conn) continue; // removed earlier in this batch
+
+        if (conn->listening) {
+            accept_conn(reactor, fd);
+            continue;
+        }
+
+        if ((events[i].events & EPOLLOUT) && conn->out) flush_buffer(reactor, conn->out);
+        // read first even on a hang up, the last packets may have come with it
+        if (events[i].events & EPOLLIN) dispatched += read_conn(reactor, fd);
+        else if (events[i].events & (EPOLLHUP | EPOLLERR)) reactor_hang_up(reactor, fd);
+    }
+    pthread_mutex_unlock(&reactor->lock);
+    return dispatched;
+}
+
+const reactor_ops_t reactor_epoll_ops = {
+    .init = epoll_init,
+    .destroy = epoll_destroy,
+    .watch = epoll_watch,
+    .unwatch = epoll_unwatch,
+    .send = epoll_send,
+    .flush = epoll_flush,
+    .poll = epoll_poll,
+};
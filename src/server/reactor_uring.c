@@ -0,0 +1,550 @@
+#define _GNU_SOURCE // for syscall and MAP_POPULATE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+
+#include "reactor_backend.h"
+
+// submission queue entries, the completion queue gets CQ_FACTOR times as many
+#define RING_ENTRIES 256
+#define CQ_FACTOR 8
+// buffers the kernel fills with whatever arrives on any socket, a power of 2
+#define BUF_COUNT 256
+#define BUF_SIZE READ_SIZE
+#define BUF_GROUP 0
+
+// what a completion is for, in the low bits of its user_data. the rest is the fd and its conn's gen, or a pointer
+enum { UD_ACCEPT = 0, UD_RECV = 1, UD_WAKEUP = 2, UD_SEND = 3, UD_CANCEL = 4 };
+#define UD_TYPE_BITS 3
+#define UD_TYPE_MASK ((1 << UD_TYPE_BITS) - 1)
+
+/**
+ * the bytes queued for one socket. only one send per socket is ever in flight, so they go out
+ * in order however the kernel splits them. a socket that stops being watched with bytes still
+ * queued keeps its stream, on a dup of the socket, until the last of them went out
+ */
+typedef struct out_stream {
+    int fd;
+    int orphan;                     // the socket was removed, fd is a dup closed once the stream is drained
+    int in_flight;
+    int broken;                     // the reader fell too far behind and the socket was shut down
+    int dirty;                      // on the dirty list
+    char *pending;                  // queued since the send in flight was submitted
+    size_t pending_len;
+    size_t pending_cap;
+    char *flight;                   // the send in flight
+    size_t flight_len;
+    size_t flight_off;              // how much of it went out already
+    size_t flight_cap;
+    struct out_stream *next;        // next on the dirty list, or the orphan list
+} out_stream_t;
+
+// The rings shared with the kernel, in reactor->backend
+typedef struct {
+    int ring_fd;
+    void *ring;                     // the submission and completion rings, mapped together
+    size_t ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *sq_flags;
+    unsigned sq_entries;
+    unsigned to_submit;             // entries queued since the last io_uring_enter
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_size;
+    char *bufs;
+    uint16_t buf_tail;
+
+    out_stream_t *dirty;            // streams with bytes queued and no send in flight
+    out_stream_t *orphans;          // streams of removed sockets still sending
+} uring_backend_t;
+
+static int io_uring_setup(unsigned entries, struct io_uring_params *params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags, void *arg, size_t arg_size) {
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+static int io_uring_register(int ring_fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+static uint64_t conn_user_data(int type, int fd, uint32_t gen) {
+    return ((uint64_t)gen << 32) | ((uint64_t)fd << UD_TYPE_BITS) | type;
+}
+
+// ---------------------------- Submission ---------------------------- //
+
+// Hands every queued entry to the kernel
+static void submit(uring_backend_t *ring) {
+    while (ring->to_submit > 0) {
+        int submitted = io_uring_enter(ring->ring_fd, ring->to_submit, 0, 0, NULL, 0);
+        if (submitted < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EBUSY) perror("[Server] io_uring_enter() failed.");
+            return; // the kernel is short on memory or completions, the next submit tries again
+        }
+        ring->to_submit -= submitted;
+    }
+}
+
+// The next free submission entry, zeroed. the queue is flushed first if it is full
+static struct io_uring_sqe *get_sqe(uring_backend_t *ring) {
+    unsigned tail = *ring->sq_tail;
+    if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) submit(ring);
+
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    return sqe;
+}
+
+// Queues the entry get_sqe handed out, for the next submit
+static void queue_sqe(uring_backend_t *ring) {
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + 1, __ATOMIC_RELEASE);
+    ring->to_submit++;
+}
+
+// Gives a buffer back to the kernel once its bytes were handled
+static void recycle_buffer(uring_backend_t *ring, uint16_t bid) {
+    struct io_uring_buf *buf = &ring->buf_ring->bufs[ring->buf_tail & (BUF_COUNT - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(ring->bufs + (size_t)bid * BUF_SIZE);
+    buf->len = BUF_SIZE;
+    buf->bid = bid;
+    ring->buf_tail++;
+    __atomic_store_n(&ring->buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE);
+}
+
+// Accepts every connection on a listening socket with one request
+static void arm_accept(uring_backend_t *ring, int fd, conn_t *conn) {
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = conn_user_data(UD_ACCEPT, fd, conn->gen);
+    queue_sqe(ring);
+}
+
+// Reads a socket into the provided buffers, until it hangs up or only up to its one packet for reactor_expect
+static void arm_recv(uring_backend_t *ring, int fd, conn_t *conn) {
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUF_GROUP;
+    if (conn->once) sqe->len = WIRE_RAW_CLIENT - conn->fill;
+    else sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->user_data = conn_user_data(UD_RECV, fd, conn->gen);
+    queue_sqe(ring);
+}
+
+// Wakes the reactor up whenever the wakeup eventfd is written to
+static void arm_wakeup(reactor_t *reactor, uring_backend_t *ring) {
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = reactor->wakeup_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = UD_WAKEUP;
+    queue_sqe(ring);
+}
+
+// ---------------------------- Sends ---------------------------- //
+
+// Sends what is left of the stream's flight
+static void queue_flight(uring_backend_t *ring, out_stream_t *out) {
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = out->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(out->flight + out->flight_off);
+    sqe->len = out->flight_len - out->flight_off;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uint64_t)(uintptr_t)out | UD_SEND;
+    queue_sqe(ring);
+    out->in_flight = 1;
+}
+
+// Puts everything a stream queued in flight, swapping its buffers instead of copying
+static void start_send(uring_backend_t *ring, out_stream_t *out) {
+    char *flight = out->flight;
+    size_t flight_cap = out->flight_cap;
+    out->flight = out->pending;
+    out->flight_cap = out->pending_cap;
+    out->flight_len = out->pending_len;
+    out->flight_off = 0;
+    out->pending = flight;
+    out->pending_cap = flight_cap;
+    out->pending_len = 0;
+    queue_flight(ring, out);
+}
+
+static void free_stream(out_stream_t *out) {
+    free(out->pending);
+    free(out->flight);
+    free(out);
+}
+
+// Takes a stream off a list linked through next
+static void unlink_stream(out_stream_t **list, out_stream_t *out) {
+    for (out_stream_t **link = list; *link; link = &(*link)->next) {
+        if (*link == out) {
+            *link = out->next;
+            return;
+        }
+    }
+}
+
+static ssize_t uring_send(reactor_t *reactor, int fd, conn_t *conn, const void *buf, size_t len) {
+    if (!conn || conn->listening) return send(fd, buf, len, MSG_NOSIGNAL);
+
+    uring_backend_t *ring = reactor->backend;
+    out_stream_t *out = conn->out;
+    if (!out) {
+        out = calloc(1, sizeof(out_stream_t));
+        if (!out) return -1;
+        out->fd = fd;
+        conn->out = out;
+    }
+    if (out->broken) return -1;
+    // a send to a reader that stopped reading never completes, and everything behind it would pile up
+    if (out->pending_len + (out->flight_len - out->flight_off) + len > MAX_BACKLOG) {
+        printf("[Server] Connection at port %d is not reading what it is sent, closing it.\n", fd);
+        out->broken = 1;
+        out->pending_len = 0;
+        // fails the send in flight and ends the recv, which hangs the socket up
+        shutdown(fd, SHUT_RDWR);
+        return -1;
+    }
+    if (out->pending_len + len > out->pending_cap) {
+        size_t cap = out->pending_cap ? out->pending_cap : 4 * sizeof(server_packet_t);
+        while (cap < out->pending_len + len) cap *= 2;
+        char *pending = realloc(out->pending, cap);
+        if (!pending) return -1;
+        out->pending = pending;
+        out->pending_cap = cap;
+    }
+    memcpy(out->pending + out->pending_len, buf, len);
+    out->pending_len += len;
+
+    // a stream with a send in flight goes on once it completes
+    if (!out->in_flight && !out->dirty) {
+        out->dirty = 1;
+        out->next = ring->dirty;
+        ring->dirty = out;
+    }
+    return len;
+}
+
+static void uring_flush(reactor_t *reactor) {
+    uring_backend_t *ring = reactor->backend;
+    while (ring->dirty) {
+        out_stream_t *out = ring->dirty;
+        ring->dirty = out->next;
+        out->next = NULL;
+        out->dirty = 0;
+        if (!out->in_flight && out->pending_len > 0) start_send(ring, out);
+    }
+    // every socket's sends in one system call
+    submit(ring);
+}
+
+// Carries on with a stream once its send completed
+static void send_done(uring_backend_t *ring, out_stream_t *out, int res) {
+    if (res > 0) {
+        out->flight_off += res;
+        if (out->flight_off < out->flight_len) {
+            queue_flight(ring, out); // the socket buffer was full, send the rest
+            return;
+        }
+    } else {
+        // the socket failed, its hang up reaches on_close through the recv
+        out->flight_off = out->flight_len;
+        out->pending_len = 0;
+    }
+    out->in_flight = 0;
+
+    if (out->pending_len > 0) {
+        start_send(ring, out);
+    } else if (out->orphan) {
+        unlink_stream(&ring->orphans, out);
+        if (out->fd >= 0) close(out->fd);
+        free_stream(out);
+    }
+}
+
+// ---------------------------- Reactor ---------------------------- //
+
+int reactor_uring_available(void) {
+    static int available = -1;
+    if (available < 0) {
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        int ring_fd = io_uring_setup(1, &params);
+        available = ring_fd >= 0 && (params.features & IORING_FEAT_SINGLE_MMAP) && (params.features & IORING_FEAT_EXT_ARG);
+        if (ring_fd >= 0) close(ring_fd);
+    }
+    return available;
+}
+
+static void uring_destroy(reactor_t *reactor) {
+    uring_backend_t *ring = reactor->backend;
+    if (!ring) return;
+    close(ring->ring_fd); // cancels whatever is still in flight
+    if (ring->ring && ring->ring != MAP_FAILED) munmap(ring->ring, ring->ring_size);
+    if (ring->sqes && ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+    if (ring->buf_ring && ring->buf_ring != MAP_FAILED) munmap(ring->buf_ring, ring->buf_ring_size);
+    free(ring->bufs);
+
+    for (int fd = 0; fd < reactor->num_conns; fd++) {
+        if (reactor->conns[fd].out) free_stream(reactor->conns[fd].out);
+        reactor->conns[fd].out = NULL;
+    }
+    while (ring->orphans) {
+        out_stream_t *out = ring->orphans;
+        ring->orphans = out->next;
+        if (out->fd >= 0) close(out->fd);
+        free_stream(out);
+    }
+    free(ring);
+    reactor->backend = NULL;
+}
+
+static int uring_init(reactor_t *reactor) {
+    uring_backend_t *ring = calloc(1, sizeof(uring_backend_t));
+    if (!ring) return -1;
+    reactor->backend = ring;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CLAMP | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_CQSIZE;
+    params.cq_entries = RING_ENTRIES * CQ_FACTOR;
+    ring->ring_fd = io_uring_setup(RING_ENTRIES, &params);
+    if (ring->ring_fd < 0) {
+        perror("[Server] io_uring_setup() failed.");
+        free(ring);
+        reactor->backend = NULL;
+        return -1;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        fprintf(stderr, "[Server] io_uring is too old for the io_uring backend.\n");
+        uring_destroy(reactor);
+        return -1;
+    }
+
+    // one mapping for both rings
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->ring_size = sq_size > cq_size ? sq_size : cq_size;
+    ring->ring = mmap(NULL, ring->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+    if (ring->ring == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        perror("[Server] mmap() of the io_uring rings failed.");
+        uring_destroy(reactor);
+        return -1;
+    }
+    char *base = ring->ring;
+    ring->sq_head = (unsigned *)(base + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(base + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(base + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(base + params.sq_off.array);
+    ring->sq_flags = (unsigned *)(base + params.sq_off.flags);
+    ring->sq_entries = params.sq_entries;
+    ring->cq_head = (unsigned *)(base + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(base + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(base + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(base + params.cq_off.cqes);
+
+    // the buffers every recv picks from, registered as a ring the kernel takes them off
+    ring->buf_ring_size = BUF_COUNT * sizeof(struct io_uring_buf);
+    ring->buf_ring = mmap(NULL, ring->buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ring->bufs = malloc((size_t)BUF_COUNT * BUF_SIZE);
+    if (ring->buf_ring == MAP_FAILED || !ring->bufs) {
+        perror("[Server] allocating the io_uring buffers failed.");
+        uring_destroy(reactor);
+        return -1;
+    }
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring->buf_ring;
+    reg.ring_entries = BUF_COUNT;
+    reg.bgid = BUF_GROUP;
+    if (io_uring_register(ring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        perror("[Server] io_uring_register() of the buffer ring failed.");
+        uring_destroy(reactor);
+        return -1;
+    }
+    for (int bid = 0; bid < BUF_COUNT; bid++) recycle_buffer(ring, bid);
+
+    arm_wakeup(reactor, ring);
+    submit(ring);
+    return 0;
+}
+
+static int uring_watch(reactor_t *reactor, int fd, conn_t *conn) {
+    uring_backend_t *ring = reactor->backend;
+    if (conn->listening) arm_accept(ring, fd, conn);
+    else arm_recv(ring, fd, conn);
+    submit(ring);
+    return 0;
+}
+
+static void uring_unwatch(reactor_t *reactor, int fd, conn_t *conn) {
+    uring_backend_t *ring = reactor->backend;
+
+    // a recv that already completed is simply not found
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = conn_user_data(conn->listening ? UD_ACCEPT : UD_RECV, fd, conn->gen);
+    sqe->user_data = UD_CANCEL;
+    queue_sqe(ring);
+
+    out_stream_t *out = conn->out;
+    conn->out = NULL;
+    if (out) {
+        if (out->dirty) unlink_stream(&ring->dirty, out);
+        out->dirty = 0;
+        if (!out->in_flight && out->pending_len == 0) {
+            free_stream(out);
+        } else {
+            // the caller closes fd next, the rest of the stream goes out on a dup
+            out->fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+            if (out->fd < 0) out->pending_len = 0;
+            out->orphan = 1;
+            out->next = ring->orphans;
+            ring->orphans = out;
+            if (!out->in_flight) {
+                if (out->pending_len > 0) {
+                    start_send(ring, out);
+                } else {
+                    unlink_stream(&ring->orphans, out);
+                    free_stream(out);
+                }
+            }
+        }
+    }
+    // nothing queued may refer to fd once it is closed
+    submit(ring);
+}
+
+// Handles one completion, with the lock held
+static int handle_cqe(reactor_t *reactor, uring_backend_t *ring, const struct io_uring_cqe *cqe) {
+    int type = cqe->user_data & UD_TYPE_MASK;
+    int more = cqe->flags & IORING_CQE_F_MORE;
+
+    if (type == UD_CANCEL) return 0;
+    if (type == UD_WAKEUP) {
+        reactor_drain_wakeup(reactor);
+        if (!more) arm_wakeup(reactor, ring);
+        return 0;
+    }
+    if (type == UD_SEND) {
+        send_done(ring, (out_stream_t *)(uintptr_t)(cqe->user_data & ~(uint64_t)UD_TYPE_MASK), cqe->res);
+        return 0;
+    }
+
+    // a completion for a socket that was removed since, or whose fd went to a new socket, is stale
+    int fd = (int)((cqe->user_data & 0xffffffffu) >> UD_TYPE_BITS);
+    uint32_t gen = (uint32_t)(cqe->user_data >> 32);
+    conn_t *conn = reactor_conn(reactor, fd);
+    if (conn && conn->gen != gen) conn = NULL;
+
+    if (type == UD_ACCEPT) {
+        if (cqe->res >= 0) {
+            if (conn) reactor_accepted(reactor, fd, cqe->res);
+            else close(cqe->res);
+        }
+        if (conn && !more) arm_accept(ring, fd, conn);
+        return 0;
+    }
+
+    int dispatched = 0;
+    int has_buffer = cqe->flags & IORING_CQE_F_BUFFER;
+    uint16_t bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    if (cqe->res > 0 && conn) {
+        dispatched = reactor_deliver(reactor, fd, ring->bufs + (size_t)bid * BUF_SIZE, cqe->res);
+    }
+    if (has_buffer) recycle_buffer(ring, bid);
+
+    if (!conn || cqe->res == -ECANCELED) return dispatched;
+    if (cqe->res == 0 || (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -EINTR)) {
+        reactor_hang_up(reactor, fd);
+        return dispatched;
+    }
+    // a recv that stopped, ran out of buffers or read only part of an expected packet goes on, if the packet
+    // handlers still watch the socket
+    conn = reactor_conn(reactor, fd);
+    if (conn && conn->gen == gen && !more) arm_recv(ring, fd, conn);
+    return dispatched;
+}
+
+static int uring_poll(reactor_t *reactor, int timeout_ms) {
+    uring_backend_t *ring = reactor->backend;
+
+    pthread_mutex_lock(&reactor->lock);
+    submit(ring);
+    pthread_mutex_unlock(&reactor->lock);
+
+    // completions already waiting, or a poll that must not wait, cost no system call at all
+    int ready = *ring->cq_head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    int overflow = __atomic_load_n(ring->sq_flags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW;
+    if ((!ready && timeout_ms != 0) || overflow) {
+        struct __kernel_timespec ts = { .tv_sec = timeout_ms / 1000, .tv_nsec = (timeout_ms % 1000) * 1000000L };
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        if (timeout_ms >= 0) arg.ts = (uint64_t)(uintptr_t)&ts;
+        int ret = io_uring_enter(ring->ring_fd, 0, ready || timeout_ms == 0 ? 0 : 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+        if (ret < 0 && errno != EINTR && errno != ETIME && errno != EBUSY) {
+            perror("[Server] io_uring_enter() failed.");
+            return -1;
+        }
+    }
+
+    int dispatched = 0;
+    pthread_mutex_lock(&reactor->lock);
+    unsigned head = *ring->cq_head;
+    while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        // copied out so the slot can go back to the kernel before the handlers run
+        struct io_uring_cqe cqe = ring->cqes[head & *ring->cq_mask];
+        __atomic_store_n(ring->cq_head, ++head, __ATOMIC_RELEASE);
+        dispatched += handle_cqe(reactor, ring, &cqe);
+        head = *ring->cq_head;
+    }
+    // the recvs re-armed and sends carried on while handling go out together
+    submit(ring);
+    pthread_mutex_unlock(&reactor->lock);
+    return dispatched;
+}
+
+const reactor_ops_t reactor_uring_ops = {
+    .init = uring_init,
+    .destroy = uring_destroy,
+    .watch = uring_watch,
+    .unwatch = uring_unwatch,
+    .send = uring_send,
+    .flush = uring_flush,
+    .poll = uring_poll,
+};
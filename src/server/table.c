@@ -0,0 +1,566 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "table.h"
+#include "client_action_handler.h"
+#include "wire.h"
+#include "equity.h"
+
+void find_next_player(game_state_t *game, int flag);
+void broadcast_end(game_state_t *game, int pid);
+void broadcast_info(game_state_t *game);
+
+// Milliseconds on the monotonic clock, for the seating deadlines
+static long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static table_t *table_of(game_state_t *game) {
+    return (table_t *)((char *)game - offsetof(table_t, game));
+}
+
+// ---------------------------- Packets ---------------------------- //
+
+// Queues a packet on the owner's reactor, in the seat's wire format, which sends it once the table waits
+static ssize_t send_to_seat(game_state_t *game, player_id_t pid, const server_packet_t *pkt) {
+    table_t *table = table_of(game);
+    if (table->wire[pid] == WIRE_RAW) return reactor_send(table->owner->reactor, game->sockets[pid], pkt, sizeof(server_packet_t));
+
+    // an INFO the table sends anyway answers a SNAPSHOT as well as one of its own
+    if (pkt->packet_type == INFO && __atomic_exchange_n(&table->snapshot_due[pid], 0, __ATOMIC_ACQ_REL)) table->sent[pid].valid = 0;
+    uint8_t frame[WIRE_MAX_FRAME];
+    size_t len = wire_encode_server(table->wire[pid], pkt, &table->sent[pid], frame);
+    return reactor_send(table->owner->reactor, game->sockets[pid], frame, len);
+}
+
+// Wakes the table up if it waits for the seat that just sent a packet or hung up
+static void seat_ready(table_t *table, player_id_t pid) {
+    if (table->waiting_on != pid) return;
+    table->waiting_on = -1;
+    worker_wake_table(table);
+}
+
+static player_id_t waiting_seat(const table_t *table);
+
+// Wakes the table up once the player it waits for ran out of time, on the owner's thread
+static void turn_timed_out(wheel_timer_t *timer, void *data) {
+    table_t *table = data;
+    pthread_mutex_lock(&table->lock);
+    // a worker running the table may have handled the player's packet after the wheel took the
+    // timer off but before this got the lock, and must not have the next player's turn cut short.
+    // the table cannot have armed the clock again meanwhile, the wheel's lock is held until this returns
+    if (table->clock_armed && table->clock_turn == table->turn && waiting_seat(table) == table->clock_seat) {
+        printf("[Server] Table %d: player %d ran out of time.\n", table->id, table->clock_seat);
+        table->clock_armed = 0;
+        table->timed_out = 1;
+        seat_ready(table, table->clock_seat);
+    }
+    pthread_mutex_unlock(&table->lock);
+}
+
+void table_queue_packet(reactor_t *reactor, int fd, const client_packet_t *pkt, void *data) {
+    table_t *table = data;
+    player_id_t overflowed = -1;
+    pthread_mutex_lock(&table->lock);
+    for (player_id_t pid = 0; pid < MAX_PLAYERS; pid++) {
+        if (table->game.sockets[pid] != fd) continue;
+
+        // answered with an INFO as soon as the table runs, even while it waits on someone else, and
+        // never taken for an action
+        if (pkt->packet_type == SNAPSHOT) {
+            __atomic_store_n(&table->snapshot_due[pid], 1, __ATOMIC_RELEASE);
+            if (table->waiting_on >= 0) seat_ready(table, table->waiting_on);
+            break;
+        }
+        if (packet_queue_push(&table->game.inbox[pid], pkt) < 0) overflowed = pid;
+        else seat_ready(table, pid);
+        break;
+    }
+    pthread_mutex_unlock(&table->lock);
+
+    // dropping the packet would lose a READY, an action or a LEAVE and leave the client waiting
+    // for its answer, so a player that far ahead of the table is taken for one that went away.
+    // on_close takes the table's lock again
+    if (overflowed >= 0) {
+        printf("[Server] Table %d: player %d sent more than %d packets out of turn, hanging up.\n", table->id, overflowed, PACKET_QUEUE_SIZE);
+        reactor_hang_up(reactor, fd);
+    }
+}
+
+void table_queue_close(reactor_t *reactor, int fd, void *data) {
+    table_t *table = data;
+    pthread_mutex_lock(&table->lock);
+    for (player_id_t pid = 0; pid < MAX_PLAYERS; pid++) {
+        if (table->game.sockets[pid] != fd) continue;
+
+        packet_queue_close(&table->game.inbox[pid]);
+        printf("[Server] Table %d: player %d disconnected.\n", table->id, pid);
+        seat_ready(table, pid);
+        break;
+    }
+    pthread_mutex_unlock(&table->lock);
+}
+
+// ---------------------------- Hand State Machine ---------------------------- //
+
+static void begin_street(table_t *table, round_stage_t stage);
+
+// Takes a player off the table for good
+static void remove_player(table_t *table, player_id_t pid) {
+    reactor_remove(table->owner->reactor, table->game.sockets[pid]);
+    close(table->game.sockets[pid]);
+}
+
+// Closes every seat that is left, the table is done
+static void close_table(table_t *table) {
+    game_state_t *game = &table->game;
+    table->state = HAND_CLOSED;
+
+    // Close all fds (you're welcome)
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (game->player_status[i] != PLAYER_LEFT) remove_player(table, i);
+    }
+}
+
+// Moves on to the next seat whose READY or LEAVE is due, or starts the hand once every seat answered
+static void next_ready_seat(table_t *table) {
+    game_state_t *game = &table->game;
+    while (table->ready_seat < MAX_PLAYERS && game->player_status[table->ready_seat] == PLAYER_LEFT) table->ready_seat++;
+    if (table->ready_seat < MAX_PLAYERS) return;
+
+    int chk_ready = server_ready(game);
+
+    if (chk_ready == 0){ // Less than 2 player ready, HALT
+        for (int i = 0; i < MAX_PLAYERS; i++){
+            if (game->player_status[i] != PLAYER_LEFT) {
+                server_packet_t server_packet;
+                server_packet.packet_type = HALT;
+                send_server_packet(game, i, &server_packet); // Sends HALT
+            }
+        }
+        close_table(table);
+        return;
+    } else if (chk_ready == -1){ // All Players Left, just close
+        close_table(table);
+        return;
+    }
+
+    reset_game_state(game); // Reset the game server, assign the cur_player based on dealer
+
+    // PREFLOP STATE
+    // DEAL TO PLAYERS
+    // PREFLOP BETTING
+    begin_street(table, ROUND_PREFLOP);
+}
+
+// INIT STATE: reads every seat's READY / LEAVE before the next hand
+static void begin_hand(table_t *table) {
+    table->game.round_stage = ROUND_INIT;
+    table->state = HAND_INIT;
+    table->ready_seat = 0;
+    next_ready_seat(table);
+}
+
+// END STATE: pays out the pot, isEnd being 1 if only one player is left who is NOT folded
+static void end_hand(table_t *table, int isEnd) {
+    game_state_t *game = &table->game;
+    printf("[Server] ENTERING END STAGE");
+    if (isEnd == 1){ // This means only one player is left who is NOT folded, find him and award him everything.
+        for (int i = 0; i < MAX_PLAYERS; i++){
+            if (game->player_status[i] != PLAYER_FOLDED && game->player_status[i] != PLAYER_LEFT) {
+
+                game->player_stacks[i] += game->pot_size; // Award the stacks to the remaining player
+                broadcast_end(game, i);
+            }
+        }
+    } else {
+        int winn = find_winner(game); // Find Winner
+
+        game->player_stacks[winn] += game->pot_size; // Award the stacks to the remaining player
+        broadcast_end(game, winn);
+    }
+
+    begin_hand(table);
+}
+
+// Moves on from a street whose betting ended, isEnd being 1 if all but one folded
+static void end_street(table_t *table, int isEnd) {
+    game_state_t *game = &table->game;
+    round_stage_t stage = game->round_stage;
+
+    if (stage != ROUND_RIVER) {
+        if (isEnd == 0) log_allin_equity(game);
+
+        for (int i = 0; i < MAX_PLAYERS; i++) game->current_bets[i] = 0 ;
+        game->highest_bet = 0;
+    }
+
+    if (isEnd == 0 && stage != ROUND_RIVER) {
+        begin_street(table, stage + 1);
+        return;
+    }
+
+    if (isEnd == 0){
+        printf("[Server] ENTERING SHOWDOWN STAGE");
+        // SHOWDOWN STATE
+        // ROUND_SHOWDOWN
+        game->round_stage = ROUND_SHOWDOWN;
+    }
+    end_hand(table, isEnd);
+}
+
+// PREFLOP, FLOP, TURN and RIVER STATES: deals the street, then waits for the first player to bet
+static void begin_street(table_t *table, round_stage_t stage) {
+    static const char *const names[] = { [ROUND_PREFLOP] = "PREFLOP", [ROUND_FLOP] = "FLOP", [ROUND_TURN] = "TURN", [ROUND_RIVER] = "RIVER" };
+    game_state_t *game = &table->game;
+
+    printf("[Server] ENTERING %s STAGE", names[stage]);
+    game->round_stage = stage;
+    if (stage == ROUND_PREFLOP) server_deal(game); // Deal Cards to all ACTIVE players
+    else server_community(game); // Adds the street's cards to community
+    broadcast_info(game); // Send INFO packet to all the ACTIVE players
+
+    table->state = HAND_BETTING;
+    int result = betting_start(game);
+    if (result != BETTING_OPEN) end_street(table, result);
+}
+
+void table_on_packet(table_t *table, player_id_t seat, const client_packet_t *pkt) {
+    game_state_t *game = &table->game;
+    client_packet_t received_packet;
+    memset(&received_packet, 0, sizeof(client_packet_t));
+    if (pkt) received_packet = *pkt;
+
+    if (table->state == HAND_BETTING) {
+        int result = betting_act(game, &received_packet, pkt ? 0 : -1);
+        if (result != BETTING_OPEN) end_street(table, result);
+        return;
+    }
+
+    if (!pkt) {
+        received_packet.packet_type = LEAVE; // A player who disconnected before the hand leaves the table
+    }
+
+    if (received_packet.packet_type == READY) {
+        printf("[Server] Player %d sent READY packet successfully.\n", seat);
+        // If READY fails because CLIENT is out of money, do nothing and mark client as LEFT (Strict)
+        if (handle_client_action(game,seat,&received_packet,NULL) == -1){ // Incase READY failed because CLIENT is out of money, they will automatically get booted out.
+            printf("[Server] Player %d sent READY packet successfully but no stacks so logging them out.\n", seat);
+            remove_player(table, seat);
+        }
+    } else if (received_packet.packet_type == LEAVE) {
+        printf("[Server] Player %d sent LEAVE packet successfully.\n", seat);
+        handle_client_action(game,seat,&received_packet,NULL);
+        remove_player(table, seat);
+    }
+
+    table->ready_seat++;
+    next_ready_seat(table);
+}
+
+void table_on_timer(table_t *table) {
+    client_packet_t received_packet;
+    memset(&received_packet, 0, sizeof(client_packet_t));
+
+    // a player who does not say READY in time sits the rest of the table out
+    if (table->state == HAND_INIT) {
+        received_packet.packet_type = LEAVE;
+        table_on_packet(table, table->ready_seat, &received_packet);
+        return;
+    }
+    int result = betting_act(&table->game, &received_packet, RECV_TIMEOUT);
+    if (result != BETTING_OPEN) end_street(table, result);
+}
+
+// The seat the table waits on, -1 once it closed
+static player_id_t waiting_seat(const table_t *table) {
+    if (table->state == HAND_INIT) return table->ready_seat;
+    if (table->state == HAND_BETTING) return table->game.current_player;
+    return -1;
+}
+
+// Whether a seat sent a SNAPSHOT that is not answered yet
+static int snapshot_due(table_t *table) {
+    for (player_id_t pid = 0; pid < MAX_PLAYERS; pid++) {
+        if (__atomic_load_n(&table->snapshot_due[pid], __ATOMIC_ACQUIRE)) return 1;
+    }
+    return 0;
+}
+
+// Sends every seat that sent a SNAPSHOT the INFO of the hand in full. between hands there is
+// nothing to send, and the first INFO of the next hand goes out in full anyway
+static void answer_snapshots(table_t *table) {
+    game_state_t *game = &table->game;
+    for (player_id_t pid = 0; pid < MAX_PLAYERS; pid++) {
+        if (!__atomic_exchange_n(&table->snapshot_due[pid], 0, __ATOMIC_ACQ_REL)) continue;
+        table->sent[pid].valid = 0;
+        if (table->state != HAND_BETTING || game->player_status[pid] == PLAYER_LEFT) continue;
+        server_packet_t info;
+        build_info_packet(game, pid, &info);
+        send_server_packet(game, pid, &info);
+    }
+}
+
+// Stops the clock of the player who just acted, so it cannot go off once the next one is up
+static void stop_clock(table_t *table) {
+    pthread_mutex_lock(&table->lock);
+    int armed = table->clock_armed;
+    table->clock_armed = 0;
+    pthread_mutex_unlock(&table->lock);
+    // outside the table's lock, turn_timed_out takes it with the wheel's lock held
+    if (armed) worker_cancel_timer(table->owner, &table->turn_timer);
+}
+
+int table_run(table_t *table) {
+    game_state_t *game = &table->game;
+    if (table->state == HAND_STARTING) {
+        game->dealer_player = -1;
+        begin_hand(table);
+    }
+
+    for (player_id_t pid = waiting_seat(table); pid >= 0; pid = waiting_seat(table)) {
+        answer_snapshots(table);
+        pthread_mutex_lock(&table->lock);
+        int has_packet = !packet_queue_empty(&game->inbox[pid]);
+        int hung_up = packet_queue_closed(&game->inbox[pid]);
+        // a SNAPSHOT that came in since is answered before the table waits
+        if (!has_packet && !hung_up && !table->timed_out && snapshot_due(table)) {
+            pthread_mutex_unlock(&table->lock);
+            continue;
+        }
+        if (!has_packet && !hung_up && !table->timed_out) {
+            // a packet that arrives after the check wakes the table up through waiting_on
+            table->waiting_on = pid;
+            // both the READY and the bets are on the clock, which runs on the owner's wheel whichever
+            // worker the table carries on on
+            int arm = game->turn_timeout_ms > 0 && !table->clock_armed;
+            if (arm) {
+                table->clock_seat = pid;
+                table->clock_turn = table->turn;
+                table->clock_armed = 1;
+            }
+            pthread_mutex_unlock(&table->lock);
+
+            if (arm) worker_arm_timer(table->owner, &table->turn_timer, game->turn_timeout_ms, turn_timed_out, table);
+            return 0;
+        }
+        pthread_mutex_unlock(&table->lock);
+
+        // once the clock is stopped it cannot go off for this turn any more
+        stop_clock(table);
+        client_packet_t pkt;
+        pthread_mutex_lock(&table->lock);
+        // a packet that made it in with the clock running out still counts
+        int received = packet_queue_pop(&game->inbox[pid], &pkt);
+        int timed_out = table->timed_out;
+        table->timed_out = 0;
+        table->turn++;
+        pthread_mutex_unlock(&table->lock);
+
+        if (received == 0) table_on_packet(table, pid, &pkt);
+        else if (hung_up) table_on_packet(table, pid, NULL);
+        else if (timed_out) table_on_timer(table);
+    }
+
+    printf("[Server] Table %d closed.\n", table->id);
+    return 1;
+}
+
+// ---------------------------- Table Pool ---------------------------- //
+
+int table_pool_init(table_pool_t *pool, const table_config_t *config, reactor_t *acceptor) {
+    memset(pool, 0, sizeof(table_pool_t));
+    pool->config = *config;
+    pool->acceptor = acceptor;
+    pthread_mutex_init(&pool->lock, NULL);
+    // before the workers, which pin themselves to a core, so the all-in equity runs on any core that is free
+    if (equity_service_start() < 0) return -1;
+    return workers_start(pool, config->num_workers);
+}
+
+void table_pool_destroy(table_pool_t *pool) {
+    workers_stop(pool);
+    equity_service_stop();
+    while (pool->free_tables) {
+        table_t *table = pool->free_tables;
+        pool->free_tables = table->next;
+        pthread_mutex_destroy(&table->lock);
+        free(table);
+    }
+    pthread_mutex_destroy(&pool->lock);
+}
+
+// Takes a table from the free list, or allocates one, and gets it ready for players to sit down
+static table_t *new_table(table_pool_t *pool) {
+    table_t *table = pool->free_tables;
+    if (table) {
+        pool->free_tables = table->next;
+    } else {
+        table = calloc(1, sizeof(table_t));
+        if (!table) return NULL;
+        pthread_mutex_init(&table->lock, NULL);
+        pool->tables_allocated++;
+    }
+
+    const table_config_t *config = &pool->config;
+    table->id = pool->tables_started++;
+    table->status = TABLE_SEATING;
+    table->seated = 0;
+    table->seat_deadline = config->join_deadline_ms > 0 ? now_ms() + config->join_deadline_ms : 0;
+    table->owner = &pool->workers[table->id % pool->num_workers];
+    table->pool = pool;
+    table->next = NULL;
+    table->state = HAND_STARTING;
+    table->clock_armed = 0;
+    table->waiting_on = -1;
+    table->queued = 0;
+    table->running = 0;
+    table->wake = 0;
+
+    init_game_state(&table->game, config->starting_stack, config->seed);
+    // the first legacy table deals exactly what a single table server dealt with the same seed
+    if (table->id > 0 || config->rng_mode != RNG_LEGACY) {
+        seed_game_rng(&table->game, config->rng_mode, rng_table_seed(config->seed, table->id));
+    }
+    table->game.send_packet = send_to_seat;
+    table->game.turn_timeout_ms = config->turn_timeout_ms;
+    table->timed_out = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        table->game.sockets[i] = -1;
+        table->wire[i] = WIRE_RAW;
+        table->sent[i].valid = 0;
+        table->snapshot_due[i] = 0;
+    }
+
+    // the thread that waits out the deadlines has one more to wait for
+    if (table->seat_deadline) reactor_wakeup(pool->acceptor);
+    return table;
+}
+
+// Starts playing hands at a table whose seats are all taken, or enough of them once its deadline passed
+static void start_table(table_pool_t *pool, table_t *table) {
+    // nobody sits down at an empty seat once the hands started
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (table->game.sockets[i] < 0) table->game.player_status[i] = PLAYER_LEFT;
+    }
+
+    table->status = TABLE_RUNNING;
+    pool->tables_running++;
+    if (table->seated == MAX_PLAYERS) printf("[Server] Table %d is full, starting on worker %d.\n", table->id, table->owner->id);
+    else printf("[Server] Table %d starting with %d players on worker %d.\n", table->id, table->seated, table->owner->id);
+
+    pthread_mutex_lock(&table->lock);
+    worker_wake_table(table);
+    pthread_mutex_unlock(&table->lock);
+}
+
+// Whether a seating table has enough players to start, with the pool's lock held
+static int can_start(const table_pool_t *pool, const table_t *table, long now) {
+    if (table->seated == MAX_PLAYERS) return 1;
+    return table->seat_deadline && now >= table->seat_deadline && table->seated >= pool->config.min_players;
+}
+
+// Takes a table off the seating list and starts it, last being the table before it
+static void unlink_and_start(table_pool_t *pool, table_t *table, table_t *last) {
+    if (last) last->next = table->next;
+    else pool->seating = table->next;
+    start_table(pool, table);
+}
+
+// Whether a seating table can take the seat, JOIN_ANY for any of them
+static int has_free_seat(const table_t *table, player_id_t seat) {
+    if (seat != JOIN_ANY) return table->game.sockets[seat] < 0;
+    return table->seated < MAX_PLAYERS;
+}
+
+table_t *table_pool_seat(table_pool_t *pool, int table_id, player_id_t *seat, int fd, int wire) {
+    if (*seat != JOIN_ANY && (*seat < 0 || *seat >= MAX_PLAYERS)) return NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    table_t *table = pool->seating;
+    table_t *last = NULL;
+    while (table && (table_id != JOIN_ANY ? table->id != table_id : !has_free_seat(table, *seat))) {
+        last = table;
+        table = table->next;
+    }
+
+    // a table that was asked for by id must be filling up and have the seat free
+    if (table_id != JOIN_ANY && (!table || !has_free_seat(table, *seat))) {
+        pthread_mutex_unlock(&pool->lock);
+        return NULL;
+    }
+
+    if (!table) {
+        if (pool->config.max_tables > 0 && pool->tables_started >= pool->config.max_tables) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        table = new_table(pool);
+        if (!table) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        if (last) last->next = table;
+        else pool->seating = table;
+    }
+
+    if (*seat == JOIN_ANY) {
+        for (*seat = 0; table->game.sockets[*seat] >= 0; (*seat)++);
+    }
+    table->game.sockets[*seat] = fd;
+    table->wire[*seat] = wire;
+    table->seated++;
+    worker_hand_off(table->owner, table, fd, wire);
+
+    // off the seating list and onto its worker's run queue
+    if (can_start(pool, table, now_ms())) unlink_and_start(pool, table, last);
+    pthread_mutex_unlock(&pool->lock);
+    return table;
+}
+
+int table_pool_start_due(table_pool_t *pool) {
+    long now = now_ms();
+    long next = -1;
+
+    pthread_mutex_lock(&pool->lock);
+    table_t *last = NULL;
+    table_t *table = pool->seating;
+    while (table) {
+        table_t *following = table->next;
+        if (can_start(pool, table, now)) {
+            unlink_and_start(pool, table, last);
+        } else {
+            // a table past its deadline without enough players starts as soon as the last one it needs sits down
+            if (table->seat_deadline > now && (next < 0 || table->seat_deadline < next)) next = table->seat_deadline;
+            last = table;
+        }
+        table = following;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return next < 0 ? -1 : (int)(next - now);
+}
+
+void table_pool_recycle(table_pool_t *pool, table_t *table) {
+    pthread_mutex_lock(&pool->lock);
+    table->status = TABLE_FREE;
+    table->next = pool->free_tables;
+    pool->free_tables = table;
+    pool->tables_running--;
+    pthread_mutex_unlock(&pool->lock);
+    reactor_wakeup(pool->acceptor);
+}
+
+int table_pool_done(table_pool_t *pool) {
+    pthread_mutex_lock(&pool->lock);
+    int done = pool->config.max_tables > 0 && pool->tables_started >= pool->config.max_tables;
+    done = done && pool->seating == NULL && pool->tables_running == 0;
+    pthread_mutex_unlock(&pool->lock);
+    return done;
+}
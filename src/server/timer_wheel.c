@@ -0,0 +1,125 @@
+#include <string.h>
+#include <time.h>
+
+#include "timer_wheel.h"
+
+#define SLOT_MASK (WHEEL_SLOTS - 1)
+// the furthest a timer can be armed ahead
+#define MAX_DELTA ((1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+
+long timer_wheel_clock_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+void timer_wheel_init(timer_wheel_t *wheel, int tick_ms, long now_ms) {
+    memset(wheel, 0, sizeof(timer_wheel_t));
+    wheel->tick_ms = tick_ms > 0 ? tick_ms : 1;
+    wheel->start_ms = now_ms;
+}
+
+// Puts an armed timer in the slot of the level that covers how far ahead it is due
+static void insert(timer_wheel_t *wheel, wheel_timer_t *timer) {
+    uint64_t delta = timer->expires - wheel->now;
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1ULL << (WHEEL_BITS * (level + 1)))) level++;
+
+    wheel_timer_t **slot = &wheel->slots[level][(timer->expires >> (WHEEL_BITS * level)) & SLOT_MASK];
+    timer->next = *slot;
+    if (*slot) (*slot)->pprev = &timer->next;
+    timer->pprev = slot;
+    *slot = timer;
+}
+
+// Takes a timer out of its slot
+static void unlink_timer(wheel_timer_t *timer) {
+    *timer->pprev = timer->next;
+    if (timer->next) timer->next->pprev = timer->pprev;
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+void timer_wheel_schedule(timer_wheel_t *wheel, wheel_timer_t *timer, long now_ms, int delay_ms, wheel_timer_fn fn, void *data) {
+    if (timer->pprev) timer_wheel_cancel(wheel, timer);
+
+    // round up, a timer never fires early
+    long due_ms = now_ms + (delay_ms > 0 ? delay_ms : 0) - wheel->start_ms;
+    uint64_t expires = due_ms > 0 ? ((uint64_t)due_ms + wheel->tick_ms - 1) / wheel->tick_ms : 0;
+    if (expires <= wheel->now) expires = wheel->now + 1;
+    if (expires - wheel->now > MAX_DELTA) expires = wheel->now + MAX_DELTA;
+
+    timer->expires = expires;
+    timer->fn = fn;
+    timer->data = data;
+    insert(wheel, timer);
+    wheel->count++;
+}
+
+void timer_wheel_cancel(timer_wheel_t *wheel, wheel_timer_t *timer) {
+    if (!timer->pprev) return;
+    unlink_timer(timer);
+    wheel->count--;
+}
+
+int timer_wheel_pending(const wheel_timer_t *timer) {
+    return timer->pprev != NULL;
+}
+
+// Moves the timers of a slot that just came up down to the levels below
+static void cascade(timer_wheel_t *wheel, int level) {
+    wheel_timer_t **slot = &wheel->slots[level][(wheel->now >> (WHEEL_BITS * level)) & SLOT_MASK];
+    wheel_timer_t *timer = *slot;
+    *slot = NULL;
+    while (timer) {
+        wheel_timer_t *next = timer->next;
+        insert(wheel, timer);
+        timer = next;
+    }
+}
+
+int timer_wheel_advance(timer_wheel_t *wheel, long now_ms) {
+    if (now_ms < wheel->start_ms) return 0;
+    uint64_t target = (uint64_t)(now_ms - wheel->start_ms) / wheel->tick_ms;
+
+    // nothing can fire on the way, skip straight there
+    if (wheel->count == 0) {
+        if (target > wheel->now) wheel->now = target;
+        return 0;
+    }
+
+    int fired = 0;
+    while (wheel->now < target) {
+        wheel->now++;
+
+        // the highest levels first, what they hand down may land in a slot that comes up now too
+        for (int level = WHEEL_LEVELS - 1; level > 0; level--) {
+            if ((wheel->now & ((1ULL << (WHEEL_BITS * level)) - 1)) == 0) cascade(wheel, level);
+        }
+
+        wheel_timer_t **slot = &wheel->slots[0][wheel->now & SLOT_MASK];
+        while (*slot) {
+            wheel_timer_t *timer = *slot;
+            unlink_timer(timer);
+            wheel->count--;
+            timer->fn(timer, timer->data);
+            fired++;
+        }
+        if (wheel->count == 0) {
+            wheel->now = target;
+            break;
+        }
+    }
+    return fired;
+}
+
+int timer_wheel_timeout(const timer_wheel_t *wheel, long now_ms) {
+    if (wheel->count == 0) return -1;
+
+    // the next due slot of level 0 before it wraps, or the wrap itself, where the next level comes up
+    uint64_t tick = wheel->now + 1;
+    while ((tick & SLOT_MASK) != 0 && !wheel->slots[0][tick & SLOT_MASK]) tick++;
+
+    long due_ms = wheel->start_ms + (long)(tick * wheel->tick_ms);
+    return due_ms > now_ms ? (int)(due_ms - now_ms) : 0;
+}
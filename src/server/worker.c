@@ -0,0 +1,277 @@
+#define _GNU_SOURCE // for pthread_setaffinity_np
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "worker.h"
+#include "table.h"
+
+// how precise the turn clocks are
+#define TIMER_TICK_MS 10
+
+// The worker of the calling thread, NULL off the worker threads
+static __thread worker_t *this_worker;
+
+// ---------------------------- Run Queues ---------------------------- //
+
+// Appends a table to a worker's run queue, with the worker's lock held
+static void push_table(worker_t *worker, table_t *table) {
+    table->run_next = NULL;
+    if (worker->run_tail) worker->run_tail->run_next = table;
+    else worker->run_head = table;
+    worker->run_tail = table;
+    worker->run_length++;
+}
+
+// Takes the oldest table off a worker's run queue, NULL if it is empty
+static table_t *pop_table(worker_t *worker) {
+    pthread_mutex_lock(&worker->lock);
+    table_t *table = worker->run_head;
+    if (table) {
+        worker->run_head = table->run_next;
+        if (!worker->run_head) worker->run_tail = NULL;
+        worker->run_length--;
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return table;
+}
+
+// Wakes one worker that sleeps with nothing to do, so it can steal a table
+static void wake_idle_worker(table_pool_t *pool, worker_t *busy) {
+    for (int i = 0; i < pool->num_workers; i++) {
+        worker_t *worker = &pool->workers[i];
+        if (worker != busy && __atomic_load_n(&worker->idle, __ATOMIC_ACQUIRE)) {
+            reactor_wakeup(worker->reactor);
+            return;
+        }
+    }
+}
+
+void worker_wake_table(table_t *table) {
+    if (table->running) {
+        table->wake = 1;
+        return;
+    }
+    if (table->queued) return;
+    table->queued = 1;
+
+    worker_t *worker = table->owner;
+    pthread_mutex_lock(&worker->lock);
+    push_table(worker, table);
+    int backlog = worker->run_length > 1;
+    pthread_mutex_unlock(&worker->lock);
+
+    // the owner picks the table up after its next poll, but someone else has to if it is busy
+    if (this_worker != worker) reactor_wakeup(worker->reactor);
+    if (backlog) wake_idle_worker(table->pool, worker);
+}
+
+// Takes a table from the run queue of the busiest other worker, NULL if they all keep up
+static table_t *steal_table(worker_t *thief) {
+    table_pool_t *pool = thief->pool;
+    worker_t *victim = NULL;
+    int longest = 0;
+    for (int i = 0; i < pool->num_workers; i++) {
+        worker_t *worker = &pool->workers[i];
+        int length = __atomic_load_n(&worker->run_length, __ATOMIC_RELAXED);
+        if (worker != thief && length > longest) {
+            victim = worker;
+            longest = length;
+        }
+    }
+    return victim ? pop_table(victim) : NULL;
+}
+
+// ---------------------------- Tables ---------------------------- //
+
+// Feeds a table the events it waits for until it has to wait again, or closes
+static void run_table(worker_t *worker, table_t *table) {
+    pthread_mutex_lock(&table->lock);
+    table->queued = 0;
+    table->running = 1;
+    table->waiting_on = -1;
+    pthread_mutex_unlock(&table->lock);
+
+    int closed = table_run(table);
+
+    // everything the table sent before it waited goes out together
+    reactor_flush(table->owner->reactor);
+
+    if (closed) {
+        table_pool_recycle(worker->pool, table);
+        return;
+    }
+
+    // only now that it stopped running may another worker pick the table up
+    pthread_mutex_lock(&table->lock);
+    table->running = 0;
+    if (table->wake) {
+        table->wake = 0;
+        worker_wake_table(table);
+    }
+    pthread_mutex_unlock(&table->lock);
+}
+
+// ---------------------------- Timers ---------------------------- //
+
+void worker_arm_timer(worker_t *worker, wheel_timer_t *timer, int delay_ms, wheel_timer_fn fn, void *data) {
+    pthread_mutex_lock(&worker->timer_lock);
+    timer_wheel_schedule(&worker->timers, timer, timer_wheel_clock_ms(), delay_ms, fn, data);
+    pthread_mutex_unlock(&worker->timer_lock);
+
+    // a worker sleeping in its reactor has to learn how long it may sleep now
+    if (this_worker != worker) reactor_wakeup(worker->reactor);
+}
+
+void worker_cancel_timer(worker_t *worker, wheel_timer_t *timer) {
+    pthread_mutex_lock(&worker->timer_lock);
+    timer_wheel_cancel(&worker->timers, timer);
+    pthread_mutex_unlock(&worker->timer_lock);
+}
+
+// Fires the timers that came due, and tells how long the worker may sleep until the next one
+static int run_timers(worker_t *worker) {
+    pthread_mutex_lock(&worker->timer_lock);
+    long now = timer_wheel_clock_ms();
+    timer_wheel_advance(&worker->timers, now);
+    int timeout = timer_wheel_timeout(&worker->timers, now);
+    pthread_mutex_unlock(&worker->timer_lock);
+    return timeout;
+}
+
+// ---------------------------- Workers ---------------------------- //
+
+// Starts watching the connections acceptors handed over
+static void take_hand_offs(worker_t *worker) {
+    pthread_mutex_lock(&worker->lock);
+    hand_off_t *hand_off = worker->hand_offs;
+    worker->hand_offs = NULL;
+    pthread_mutex_unlock(&worker->lock);
+
+    while (hand_off) {
+        hand_off_t *next = hand_off->next;
+        if (reactor_add(worker->reactor, hand_off->fd, hand_off->table) < 0) {
+            // the table finds out it is gone the first time it waits for the seat
+            table_queue_close(worker->reactor, hand_off->fd, hand_off->table);
+        } else {
+            // nothing is read before this worker's next poll
+            reactor_set_wire(worker->reactor, hand_off->fd, hand_off->wire);
+        }
+        free(hand_off);
+        hand_off = next;
+    }
+}
+
+void worker_hand_off(worker_t *worker, table_t *table, int fd, int wire) {
+    hand_off_t *hand_off = malloc(sizeof(hand_off_t));
+    hand_off->table = table;
+    hand_off->fd = fd;
+    hand_off->wire = wire;
+
+    pthread_mutex_lock(&worker->lock);
+    hand_off->next = worker->hand_offs;
+    worker->hand_offs = hand_off;
+    pthread_mutex_unlock(&worker->lock);
+    reactor_wakeup(worker->reactor);
+}
+
+static void *worker_main(void *arg) {
+    worker_t *worker = arg;
+    this_worker = worker;
+
+    while (!__atomic_load_n(&worker->stop, __ATOMIC_ACQUIRE)) {
+        take_hand_offs(worker);
+        int timeout = run_timers(worker);
+
+        // pick up whatever arrived without waiting, then run every table it woke up
+        if (reactor_poll(worker->reactor, 0) < 0) break;
+        int ran = 0;
+        for (int budget = __atomic_load_n(&worker->run_length, __ATOMIC_RELAXED); budget > 0; budget--) {
+            table_t *table = pop_table(worker);
+            if (!table) break;
+            run_table(worker, table);
+            ran++;
+        }
+        if (ran) continue;
+
+        table_t *table = steal_table(worker);
+        if (table) {
+            run_table(worker, table);
+            continue;
+        }
+
+        // nothing to run here or anywhere else: sleep until a packet, a hand off, a busy worker or a timer wakes us
+        __atomic_store_n(&worker->idle, 1, __ATOMIC_RELEASE);
+        table = steal_table(worker);
+        if (table) {
+            __atomic_store_n(&worker->idle, 0, __ATOMIC_RELEASE);
+            run_table(worker, table);
+            continue;
+        }
+        if (__atomic_load_n(&worker->run_length, __ATOMIC_RELAXED) == 0) {
+            if (reactor_poll(worker->reactor, timeout) < 0) break;
+        }
+        __atomic_store_n(&worker->idle, 0, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+// Keeps a worker on one core, so its tables' state stays in that core's caches
+static void pin_worker(worker_t *worker) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(worker->id % CPU_SETSIZE, &cpus);
+    pthread_setaffinity_np(worker->thread, sizeof(cpus), &cpus);
+}
+
+int workers_start(table_pool_t *pool, int num_workers) {
+    int num_cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_workers <= 0) num_workers = num_cores > 0 ? num_cores : 1;
+
+    pool->workers = calloc(num_workers, sizeof(worker_t));
+    if (!pool->workers) return -1;
+    pool->num_workers = num_workers;
+
+    for (int i = 0; i < num_workers; i++) {
+        worker_t *worker = &pool->workers[i];
+        worker->id = i;
+        worker->pool = pool;
+        pthread_mutex_init(&worker->lock, NULL);
+        pthread_mutex_init(&worker->timer_lock, NULL);
+        timer_wheel_init(&worker->timers, TIMER_TICK_MS, timer_wheel_clock_ms());
+        worker->reactor = reactor_create(pool->config.backend, NULL, table_queue_packet, table_queue_close);
+        if (!worker->reactor) return -1;
+    }
+
+    for (int i = 0; i < num_workers; i++) {
+        worker_t *worker = &pool->workers[i];
+        if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+            perror("[Server] pthread_create() failed.");
+            return -1;
+        }
+        if (num_workers <= num_cores) pin_worker(worker);
+    }
+    printf("[Server] Running tables on %d worker threads.\n", num_workers);
+    return 0;
+}
+
+void workers_stop(table_pool_t *pool) {
+    for (int i = 0; i < pool->num_workers; i++) {
+        __atomic_store_n(&pool->workers[i].stop, 1, __ATOMIC_RELEASE);
+        reactor_wakeup(pool->workers[i].reactor);
+    }
+    for (int i = 0; i < pool->num_workers; i++) {
+        worker_t *worker = &pool->workers[i];
+        pthread_join(worker->thread, NULL);
+        reactor_destroy(worker->reactor);
+        pthread_mutex_destroy(&worker->lock);
+        pthread_mutex_destroy(&worker->timer_lock);
+    }
+    free(pool->workers);
+    pool->workers = NULL;
+    pool->num_workers = 0;
+}
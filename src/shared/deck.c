@@ -0,0 +1,38 @@
+#include "deck.h"
+
+void deck_init(deck_t *deck, rng_mode_t mode, uint64_t seed) {
+    // the same order init_deck puts the cards in
+    for (card_t card = 0; card < DECK_SIZE; card++) deck->cards[card] = card;
+    deck->dealt = 0;
+    rng_seed(&deck->rng, mode, seed);
+}
+
+void deck_seed(deck_t *deck, rng_mode_t mode, uint64_t seed) {
+    rng_seed(&deck->rng, mode, seed);
+}
+
+void deck_reset(deck_t *deck) {
+    deck->dealt = 0;
+
+    // the legacy shuffle swaps every position with any other, the last swap can still move the
+    // first card, so it cannot be done lazily. shuffle everything now and deal from the top
+    if (deck->rng.mode == RNG_LEGACY) rng_shuffle_deck(&deck->rng, deck->cards);
+}
+
+card_t deck_draw(deck_t *deck) {
+    if (deck->dealt == DECK_SIZE) return NOCARD;
+    if (deck->rng.mode == RNG_LEGACY) return deck->cards[deck->dealt++];
+
+    // one step of Fisher-Yates, the same step rng_shuffle_deck takes for this position. it works
+    // from the back of the deck, so the k-th card dealt is the one it would leave at DECK_SIZE - 1 - k
+    int i = DECK_SIZE - 1 - deck->dealt++;
+    int j = rng_bounded(&deck->rng, i + 1);
+    card_t card = deck->cards[j];
+    deck->cards[j] = deck->cards[i];
+    deck->cards[i] = card;
+    return card;
+}
+
+int deck_remaining(const deck_t *deck) {
+    return DECK_SIZE - deck->dealt;
+}
@@ -0,0 +1,661 @@
+#include "hand_eval.h"
+#include "card_set.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAND_EVAL_X86 1
+#endif
+
+/**
+ * Table driven seven card evaluator.
+ *
+ * Every rank gets a key chosen so that the sum of the keys of any seven ranks (at most four of
+ * each) is unique. Hands without a flush are then scored by looking that sum up in a perfect hash
+ * table, while flushes are scored by looking the 13 bit rank mask of the flush suit up in a
+ * second table. Laying out the perfect hash takes a while, so `make tables` does it once with
+ * hand_eval_write_tables and every process maps the resulting file at startup. Both tables store
+ * scores in the same [HAND_RANK]20 [Tie]16..0 encoding that calculate_5card_value produces, so
+ * find_winner can keep comparing plain ints.
+ *
+ * hand_eval_card_set scores a card_set_t of up to seven cards with bit operations on the suit
+ * lanes plus two small tables indexed by a 13 bit rank mask (straights and the top five ranks).
+ *
+ * hand_eval_batch scores many hole card pairs against one board. The board's key and suit counts
+ * are computed once, then SSE4.1 or AVX2 kernels add the hole cards and probe the tables for 4 or
+ * 8 hands at a time. Flushes are rare enough that the kernels only flag them and let the scalar
+ * path redo those lanes.
+ *
+ * hand_board_t carries the board's key, suit counts and card set from street to street, so the
+ * server sums the board as server_community deals it and a showdown only adds two hole cards.
+ */
+
+#define NUM_RANKS 13
+#define NUM_SUITS 4
+#define RANK_MASK_SIZE (1 << NUM_RANKS)
+
+// largest possible key sum, four aces and three kings
+#define NOFLUSH_MAX_KEY (4 * 1479181 + 3 * 636345)
+
+// the perfect hash splits a key into a row (upper bits) and a column (lower bits)
+// and every row is displaced by an offset so that no two keys land on the same slot
+#define ROW_SHIFT 10
+#define ROW_MASK ((1 << ROW_SHIFT) - 1)
+#define NUM_ROWS ((NOFLUSH_MAX_KEY >> ROW_SHIFT) + 1)
+
+// number of distinct seven card rank multisets
+#define NUM_NOFLUSH_HANDS 49205
+
+static const uint32_t rank_keys[NUM_RANKS] = {
+    0, 1, 5, 22, 98, 453, 2031, 8698, 22854, 83661, 262349, 636345, 1479181
+};
+
+// the perfect hash lives in a file made by hand_eval_write_tables and is mapped read-only, so
+// every process on the host shares the same pages. both stay NULL if the file could not be mapped
+static const uint32_t *noflush_offsets = NULL;
+static const int *noflush_table = NULL;
+
+static int flush_table[RANK_MASK_SIZE];
+static unsigned char straight_table[RANK_MASK_SIZE];
+static int top_five_table[RANK_MASK_SIZE];
+
+// per card lookups for the batch kernels: the rank key, and a 1 in the byte of the card's suit
+static uint32_t card_keys[DECK_SIZE];
+static uint32_t card_suit_counts[DECK_SIZE];
+
+// adding this to packed suit counts sets the top bit of a byte exactly when it reached 5
+#define SUIT_COUNT_FLUSH_BIAS 0x7b7b7b7bu
+#define SUIT_COUNT_FLUSH_BITS 0x80808080u
+
+static hand_eval_kernel_t best_kernel = HAND_EVAL_KERNEL_SCALAR;
+
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+// index of the highest rank in a non empty rank mask
+#define HIGHEST_RANK(mask) (31 - __builtin_clz(mask))
+
+// Packs the n highest ranks of the mask as tiebreakers, highest first
+static int top_ranks(int mask, int n) {
+    int points = 0;
+    int shift = 16;
+    for (int r = NUM_RANKS - 1; r >= 0 && n > 0; r--) {
+        if (mask & (1 << r)) {
+            points |= (r + 2) << shift;
+            shift -= 4;
+            n--;
+        }
+    }
+    return points;
+}
+
+// Returns the rank of the top card of the best straight in the mask, 0 if there is none
+static int straight_high(int mask) {
+    for (int top = NUM_RANKS - 1; top >= 4; top--) {
+        if (((mask >> (top - 4)) & 0x1f) == 0x1f) return top + 2;
+    }
+    if ((mask & 0x100f) == 0x100f) return 5; // A-5-4-3-2
+    return 0;
+}
+
+// Scores the best hand that can be made from a rank mask of a single suit
+static int score_flush(int mask) {
+    int high = straight_high(mask);
+    if (high) return (9 << 20) | (high << 16);
+    return (6 << 20) | top_ranks(mask, 5);
+}
+
+// Scores the best hand that can be made from rank counts when there is no flush
+static int score_rank_counts(const int counts[NUM_RANKS]) {
+    int mask = 0;
+    int quad = -1;
+    int trip = -1;
+    int pairs[2] = {-1, -1};
+
+    for (int r = NUM_RANKS - 1; r >= 0; r--) {
+        if (counts[r] > 0) mask |= 1 << r;
+        if (counts[r] == 4 && quad < 0) quad = r;
+        if (counts[r] == 3 && trip < 0) trip = r;
+    }
+
+    // Pairs that could go with the trips, a second set of trips counts as a pair
+    for (int r = NUM_RANKS - 1; r >= 0; r--) {
+        if (r == trip || counts[r] < 2) continue;
+        if (pairs[0] < 0) pairs[0] = r;
+        else if (pairs[1] < 0) pairs[1] = r;
+    }
+
+    if (quad >= 0) return (8 << 20) | ((quad + 2) << 16);
+    if (trip >= 0 && pairs[0] >= 0) return (7 << 20) | ((trip + 2) << 16) | ((pairs[0] + 2) << 12);
+
+    int high = straight_high(mask);
+    if (high) return (5 << 20) | (high << 16);
+
+    if (trip >= 0) return (4 << 20) | ((trip + 2) << 16);
+    if (pairs[1] >= 0) return (3 << 20) | ((pairs[0] + 2) << 16) | ((pairs[1] + 2) << 12);
+    if (pairs[0] >= 0) return (2 << 20) | ((pairs[0] + 2) << 16);
+    return (1 << 20) | top_ranks(mask, 5);
+}
+
+static int compare_keys(const void *a, const void *b) {
+    uint32_t key_a = *(const uint32_t *)a;
+    uint32_t key_b = *(const uint32_t *)b;
+    return (key_a > key_b) - (key_a < key_b);
+}
+
+// Walks every multiset of seven ranks, recording its key and score
+static int collect_noflush_hands(int rank, int left, int counts[NUM_RANKS], uint32_t key,
+                                 uint32_t *keys, int *scores, int n) {
+    if (rank == NUM_RANKS) {
+        if (left == 0) {
+            keys[n] = key;
+            scores[n] = score_rank_counts(counts);
+            n++;
+        }
+        return n;
+    }
+    for (int c = 0; c <= 4 && c <= left; c++) {
+        counts[rank] = c;
+        n = collect_noflush_hands(rank + 1, left - c, counts, key + c * rank_keys[rank], keys, scores, n);
+    }
+    counts[rank] = 0;
+    return n;
+}
+
+// Reads the 64 occupancy bits starting at pos
+static uint64_t used_bits_at(const uint64_t *used, size_t pos) {
+    uint64_t bits = used[pos >> 6] >> (pos & 63);
+    if (pos & 63) bits |= used[(pos >> 6) + 1] << (64 - (pos & 63));
+    return bits;
+}
+
+// Places the densest rows first, each at the lowest offset where none of its keys collide.
+// Fills offsets (NUM_ROWS entries), allocates *table and returns its size
+static int build_noflush_table(const uint32_t *keys, const int *scores, int n, uint32_t *offsets, int **table) {
+    static int row_counts[NUM_ROWS];
+    static int row_order[NUM_ROWS];
+    static uint32_t *row_keys[NUM_ROWS];
+
+    uint32_t *sorted = malloc(n * sizeof(uint32_t));
+    int *fill = calloc(NUM_ROWS, sizeof(int));
+
+    memset(row_counts, 0, sizeof(row_counts));
+    for (int i = 0; i < n; i++) row_counts[keys[i] >> ROW_SHIFT]++;
+
+    int start = 0;
+    for (int row = 0; row < NUM_ROWS; row++) {
+        row_keys[row] = sorted + start;
+        start += row_counts[row];
+        row_order[row] = row;
+    }
+    for (int i = 0; i < n; i++) {
+        int row = keys[i] >> ROW_SHIFT;
+        row_keys[row][fill[row]++] = keys[i] & ROW_MASK;
+    }
+    for (int row = 0; row < NUM_ROWS; row++) {
+        qsort(row_keys[row], row_counts[row], sizeof(uint32_t), compare_keys);
+    }
+
+    // insertion sort is plenty for a few thousand rows
+    for (int i = 1; i < NUM_ROWS; i++) {
+        int row = row_order[i];
+        int j = i - 1;
+        while (j >= 0 && row_counts[row_order[j]] < row_counts[row]) {
+            row_order[j + 1] = row_order[j];
+            j--;
+        }
+        row_order[j + 1] = row;
+    }
+
+    // a plain direct table always fits, so this bounds every offset we can end up choosing
+    uint64_t *used = calloc((((size_t)NUM_ROWS << ROW_SHIFT) >> 6) + 2, sizeof(uint64_t));
+    int size = 0;
+    int first_free = 0;
+
+    for (int i = 0; i < NUM_ROWS; i++) {
+        int row = row_order[i];
+        int count = row_counts[row];
+        if (count == 0) {
+            offsets[row] = 0;
+            continue;
+        }
+        while (used[first_free >> 6] & (1ull << (first_free & 63))) first_free++;
+
+        // test 64 candidate offsets at once, a bit survives only if every key of the row is free there
+        int base = first_free - (int)row_keys[row][0];
+        if (base < 0) base = 0;
+        for (;; base += 64) {
+            uint64_t candidates = ~0ull;
+            for (int k = 0; k < count && candidates; k++) {
+                candidates &= ~used_bits_at(used, base + row_keys[row][k]);
+            }
+            if (!candidates) continue;
+
+            int offset = base + __builtin_ctzll(candidates);
+            for (int k = 0; k < count; k++) {
+                int slot = offset + row_keys[row][k];
+                used[slot >> 6] |= 1ull << (slot & 63);
+                if (slot >= size) size = slot + 1;
+            }
+            offsets[row] = offset;
+            break;
+        }
+    }
+
+    *table = calloc(size, sizeof(int));
+    for (int i = 0; i < n; i++) {
+        (*table)[offsets[keys[i] >> ROW_SHIFT] + (keys[i] & ROW_MASK)] = scores[i];
+    }
+
+    free(used);
+    free(fill);
+    free(sorted);
+    return size;
+}
+
+// ---------------------------- Table file ---------------------------- //
+
+/**
+ * Layout of the table file, all in host byte order:
+ *      tables_header_t
+ *      uint32_t offsets[num_rows]
+ *      int scores[table_size]
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;          // TABLES_BYTE_ORDER as written, catches files from other hosts
+    uint32_t row_shift;
+    uint32_t num_rows;
+    uint32_t table_size;
+    uint32_t rank_keys[NUM_RANKS];
+} tables_header_t;
+
+#define TABLES_MAGIC "PKREVAL"
+#define TABLES_BYTE_ORDER 0x01020304u
+
+int hand_eval_write_tables(const char *path) {
+    uint32_t *keys = malloc(NUM_NOFLUSH_HANDS * sizeof(uint32_t));
+    int *scores = malloc(NUM_NOFLUSH_HANDS * sizeof(int));
+    uint32_t *offsets = malloc(NUM_ROWS * sizeof(uint32_t));
+    int *table = NULL;
+    int counts[NUM_RANKS] = {0};
+
+    int n = collect_noflush_hands(0, HAND_EVAL_CARDS, counts, 0, keys, scores, 0);
+    assert(n == NUM_NOFLUSH_HANDS);
+    int size = build_noflush_table(keys, scores, n, offsets, &table);
+
+    tables_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TABLES_MAGIC, sizeof(TABLES_MAGIC));
+    header.version = HAND_EVAL_TABLES_VERSION;
+    header.byte_order = TABLES_BYTE_ORDER;
+    header.row_shift = ROW_SHIFT;
+    header.num_rows = NUM_ROWS;
+    header.table_size = size;
+    memcpy(header.rank_keys, rank_keys, sizeof(rank_keys));
+
+    // write next to the target and rename over it, so a process mapping the file never sees half of it
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, getpid());
+
+    int ret = -1;
+    FILE *file = fopen(tmp_path, "wb");
+    if (file) {
+        int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                 fwrite(offsets, sizeof(uint32_t), NUM_ROWS, file) == NUM_ROWS &&
+                 fwrite(table, sizeof(int), size, file) == (size_t)size;
+        if (fclose(file) == 0 && ok && rename(tmp_path, path) == 0) ret = 0;
+        else unlink(tmp_path);
+    }
+
+    free(table);
+    free(offsets);
+    free(scores);
+    free(keys);
+    return ret;
+}
+
+// Maps the table file read-only and points the lookups at it, returns 0 on success
+static int map_tables(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(tables_header_t)) {
+        close(fd);
+        return -1;
+    }
+
+    // MAP_SHARED on a read-only file keeps a single copy of the pages in the page cache for everyone
+    void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return -1;
+
+    const tables_header_t *header = mapped;
+    size_t expected = sizeof(tables_header_t) + (size_t)header->num_rows * sizeof(uint32_t) +
+                      (size_t)header->table_size * sizeof(int);
+
+    if (memcmp(header->magic, TABLES_MAGIC, sizeof(TABLES_MAGIC)) != 0 ||
+        header->version != HAND_EVAL_TABLES_VERSION ||
+        header->byte_order != TABLES_BYTE_ORDER ||
+        header->row_shift != ROW_SHIFT ||
+        header->num_rows != NUM_ROWS ||
+        memcmp(header->rank_keys, rank_keys, sizeof(rank_keys)) != 0 ||
+        (size_t)st.st_size != expected) {
+        munmap(mapped, st.st_size);
+        return -1;
+    }
+
+    posix_madvise(mapped, st.st_size, POSIX_MADV_WILLNEED);
+    noflush_offsets = (const uint32_t *)(header + 1);
+    noflush_table = (const int *)(noflush_offsets + NUM_ROWS);
+    return 0;
+}
+
+static void build_tables(void) {
+    // the 13 bit mask tables take well under a millisecond, they are always built in process
+    for (int mask = 0; mask < RANK_MASK_SIZE; mask++) {
+        flush_table[mask] = __builtin_popcount(mask) >= 5 ? score_flush(mask) : 0;
+        straight_table[mask] = straight_high(mask);
+        top_five_table[mask] = top_ranks(mask, 5);
+    }
+
+    for (card_t card = 0; card < DECK_SIZE; card++) {
+        card_keys[card] = rank_keys[RANK(card)];
+        card_suit_counts[card] = 1u << (8 * SUITE(card));
+    }
+
+    const char *path = getenv(HAND_EVAL_TABLES_ENV);
+    map_tables(path ? path : HAND_EVAL_TABLES_PATH);
+
+#ifdef HAND_EVAL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) best_kernel = HAND_EVAL_KERNEL_AVX2;
+    else if (__builtin_cpu_supports("sse4.1")) best_kernel = HAND_EVAL_KERNEL_SSE4;
+#endif
+}
+
+void hand_eval_init(void) {
+    pthread_once(&tables_once, build_tables);
+}
+
+int hand_eval_tables_loaded(void) {
+    return noflush_table != NULL;
+}
+
+// Scores seven cards given their summed rank keys and their card set
+static inline int score_keyed(uint32_t key, card_set_t set) {
+    // with seven cards at most one suit can hold five, and no full house or quads fit alongside it
+    int flush_suit = card_set_flush_suit(set);
+    if (flush_suit >= 0) return flush_table[card_set_suit(set, flush_suit)];
+
+    // without the mapped tables everything is worked out from the card set instead
+    if (!noflush_table) return hand_eval_card_set(set);
+
+    return noflush_table[noflush_offsets[key >> ROW_SHIFT] + (key & ROW_MASK)];
+}
+
+int hand_eval7(const card_t cards[HAND_EVAL_CARDS]) {
+    uint32_t key = 0;
+    card_set_t set = 0;
+
+    for (int i = 0; i < HAND_EVAL_CARDS; i++) {
+        key += rank_keys[RANK(cards[i])];
+        set |= card_set_of(cards[i]);
+    }
+
+    return score_keyed(key, set);
+}
+
+int hand_eval_card_set(card_set_t cards) {
+    assert(card_set_size(cards) <= HAND_EVAL_CARDS); // eight cards could hold a flush and a full house
+    int flush_suit = card_set_flush_suit(cards);
+    if (flush_suit >= 0) return flush_table[card_set_suit(cards, flush_suit)];
+
+    int d = card_set_suit(cards, DIAMOND);
+    int c = card_set_suit(cards, CLUB);
+    int h = card_set_suit(cards, HEART);
+    int s = card_set_suit(cards, SPADE);
+
+    // ranks held at least once, twice, three times and four times
+    int ranks = d | c | h | s;
+    int pairs = (d & c) | (h & s) | ((d | c) & (h | s));
+    int trips = (d & c & (h | s)) | (h & s & (d | c));
+    int quads = d & c & h & s;
+
+    if (quads) return (8 << 20) | ((HIGHEST_RANK(quads) + 2) << 16);
+
+    int trip = trips ? HIGHEST_RANK(trips) : -1;
+    int house_pair = pairs & ~(trips ? 1 << trip : 0);
+    if (trips && house_pair) return (7 << 20) | ((trip + 2) << 16) | ((HIGHEST_RANK(house_pair) + 2) << 12);
+
+    if (straight_table[ranks]) return (5 << 20) | (straight_table[ranks] << 16);
+    if (trips) return (4 << 20) | ((trip + 2) << 16);
+
+    if (pairs) {
+        int high_pair = HIGHEST_RANK(pairs);
+        int low_pairs = pairs & ~(1 << high_pair);
+        if (low_pairs) return (3 << 20) | ((high_pair + 2) << 16) | ((HIGHEST_RANK(low_pairs) + 2) << 12);
+        return (2 << 20) | ((high_pair + 2) << 16);
+    }
+
+    return (1 << 20) | top_five_table[ranks];
+}
+
+// ---------------------------- Batch evaluation ---------------------------- //
+
+// Folds one card into the board's sums, without touching best_score
+static inline void board_add_card(hand_board_t *board, card_t card) {
+    board->key += rank_keys[RANK(card)];
+    board->suit_counts += card_suit_counts[card];
+    board->cards |= card_set_of(card);
+    board->num_cards++;
+}
+
+static inline int score_with_board(const hand_board_t *board, const card_t hole[2]) {
+    uint32_t key = board->key + card_keys[hole[0]] + card_keys[hole[1]];
+    return score_keyed(key, board->cards | card_set_of(hole[0]) | card_set_of(hole[1]));
+}
+
+static void batch_scalar(const hand_board_t *board, const card_t hole_cards[][2], int from, int to, int scores[]) {
+    for (int i = from; i < to; i++) {
+        scores[i] = score_with_board(board, hole_cards[i]);
+    }
+}
+
+#ifdef HAND_EVAL_X86
+
+// The kernels score whole vectors of hands and return how many they got through,
+// hand_eval_batch_kernel passes the leftovers on to a narrower kernel
+
+__attribute__((target("sse4.1")))
+static int batch_sse4(const hand_board_t *board, const card_t hole_cards[][2], int num_hands, int scores[]) {
+    const __m128i board_key = _mm_set1_epi32(board->key);
+    const __m128i board_suits = _mm_set1_epi32(board->suit_counts);
+    const __m128i flush_bias = _mm_set1_epi32(SUIT_COUNT_FLUSH_BIAS);
+    const __m128i flush_bits = _mm_set1_epi32(SUIT_COUNT_FLUSH_BITS);
+    const __m128i row_mask = _mm_set1_epi32(ROW_MASK);
+
+    int i = 0;
+    for (; i + 4 <= num_hands; i += 4) {
+        const card_t *h = hole_cards[i];
+        __m128i key = _mm_add_epi32(board_key, _mm_setr_epi32(
+            card_keys[h[0]] + card_keys[h[1]], card_keys[h[2]] + card_keys[h[3]],
+            card_keys[h[4]] + card_keys[h[5]], card_keys[h[6]] + card_keys[h[7]]));
+        __m128i suits = _mm_add_epi32(board_suits, _mm_setr_epi32(
+            card_suit_counts[h[0]] + card_suit_counts[h[1]], card_suit_counts[h[2]] + card_suit_counts[h[3]],
+            card_suit_counts[h[4]] + card_suit_counts[h[5]], card_suit_counts[h[6]] + card_suit_counts[h[7]]));
+
+        __m128i row = _mm_srli_epi32(key, ROW_SHIFT);
+        __m128i col = _mm_and_si128(key, row_mask);
+        __m128i flush = _mm_and_si128(_mm_add_epi32(suits, flush_bias), flush_bits);
+
+        // no gathers before AVX2, the table probes go lane by lane
+        scores[i + 0] = noflush_table[noflush_offsets[_mm_extract_epi32(row, 0)] + _mm_extract_epi32(col, 0)];
+        scores[i + 1] = noflush_table[noflush_offsets[_mm_extract_epi32(row, 1)] + _mm_extract_epi32(col, 1)];
+        scores[i + 2] = noflush_table[noflush_offsets[_mm_extract_epi32(row, 2)] + _mm_extract_epi32(col, 2)];
+        scores[i + 3] = noflush_table[noflush_offsets[_mm_extract_epi32(row, 3)] + _mm_extract_epi32(col, 3)];
+
+        if (!_mm_testz_si128(flush, flush)) {
+            int lanes = ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(flush, _mm_setzero_si128()))) & 0xf;
+            for (; lanes; lanes &= lanes - 1) {
+                int lane = i + __builtin_ctz(lanes);
+                scores[lane] = score_with_board(board, hole_cards[lane]);
+            }
+        }
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int batch_avx2(const hand_board_t *board, const card_t hole_cards[][2], int num_hands, int scores[]) {
+    const __m256i board_key = _mm256_set1_epi32(board->key);
+    const __m256i board_suits = _mm256_set1_epi32(board->suit_counts);
+    const __m256i flush_bias = _mm256_set1_epi32(SUIT_COUNT_FLUSH_BIAS);
+    const __m256i flush_bits = _mm256_set1_epi32(SUIT_COUNT_FLUSH_BITS);
+    const __m256i row_mask = _mm256_set1_epi32(ROW_MASK);
+    const __m256i deinterleave = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    const __m256i suit_mask = _mm256_set1_epi32((1 << SUITE_BITS) - 1);
+    const __m256i high_ranks = _mm256_set1_epi32(7);
+    const __m256i ones = _mm256_set1_epi32(1);
+
+    // the 13 rank keys split over two registers, so a key is a permute instead of a gather
+    const __m256i low_keys = _mm256_loadu_si256((const __m256i *)rank_keys);
+    const __m256i high_keys = _mm256_setr_epi32(rank_keys[8], rank_keys[9], rank_keys[10], rank_keys[11],
+                                                rank_keys[12], 0, 0, 0);
+
+    int rows[8] __attribute__((aligned(32)));
+    int cols[8] __attribute__((aligned(32)));
+
+    int i = 0;
+    for (; i + 8 <= num_hands; i += 8) {
+        // 8 pairs come in as a0 b0 a1 b1 ..., split them into the first and second hole card
+        __m256i lo = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)hole_cards[i]), deinterleave);
+        __m256i hi = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)hole_cards[i + 4]), deinterleave);
+        __m256i first = _mm256_permute2x128_si256(lo, hi, 0x20);
+        __m256i second = _mm256_permute2x128_si256(lo, hi, 0x31);
+
+        __m256i first_rank = _mm256_srli_epi32(first, SUITE_BITS);
+        __m256i second_rank = _mm256_srli_epi32(second, SUITE_BITS);
+        __m256i first_key = _mm256_blendv_epi8(_mm256_permutevar8x32_epi32(low_keys, first_rank),
+                                               _mm256_permutevar8x32_epi32(high_keys, first_rank),
+                                               _mm256_cmpgt_epi32(first_rank, high_ranks));
+        __m256i second_key = _mm256_blendv_epi8(_mm256_permutevar8x32_epi32(low_keys, second_rank),
+                                                _mm256_permutevar8x32_epi32(high_keys, second_rank),
+                                                _mm256_cmpgt_epi32(second_rank, high_ranks));
+        __m256i key = _mm256_add_epi32(board_key, _mm256_add_epi32(first_key, second_key));
+
+        // 1 << (8 * suit) per card, added into the board's packed suit counts
+        __m256i first_suit = _mm256_sllv_epi32(ones, _mm256_slli_epi32(_mm256_and_si256(first, suit_mask), 3));
+        __m256i second_suit = _mm256_sllv_epi32(ones, _mm256_slli_epi32(_mm256_and_si256(second, suit_mask), 3));
+        __m256i suits = _mm256_add_epi32(board_suits, _mm256_add_epi32(first_suit, second_suit));
+
+        // gathers are microcoded (and slow) on many cpus, the two table probes go lane by lane
+        _mm256_store_si256((__m256i *)rows, _mm256_srli_epi32(key, ROW_SHIFT));
+        _mm256_store_si256((__m256i *)cols, _mm256_and_si256(key, row_mask));
+        for (int lane = 0; lane < 8; lane++) {
+            scores[i + lane] = noflush_table[noflush_offsets[rows[lane]] + cols[lane]];
+        }
+
+        __m256i flush = _mm256_and_si256(_mm256_add_epi32(suits, flush_bias), flush_bits);
+        if (!_mm256_testz_si256(flush, flush)) {
+            int lanes = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(flush, _mm256_setzero_si256()))) & 0xff;
+            for (; lanes; lanes &= lanes - 1) {
+                int lane = i + __builtin_ctz(lanes);
+                scores[lane] = score_with_board(board, hole_cards[lane]);
+            }
+        }
+    }
+    return i;
+}
+
+#endif
+
+hand_eval_kernel_t hand_eval_best_kernel(void) {
+    hand_eval_init();
+    return best_kernel;
+}
+
+const char *hand_eval_kernel_name(hand_eval_kernel_t kernel) {
+    switch (kernel) {
+        case HAND_EVAL_KERNEL_AVX2:
+            return "avx2";
+        case HAND_EVAL_KERNEL_SSE4:
+            return "sse4.1";
+        case HAND_EVAL_KERNEL_SCALAR:
+        default:
+            return "scalar";
+    }
+}
+
+void hand_eval_batch_board(hand_eval_kernel_t kernel, const hand_board_t *board,
+                           const card_t hole_cards[][2], int num_hands, int scores[]) {
+    int done = 0;
+
+    // the key table only covers seven cards, earlier streets go through the card set evaluator
+    if (board->num_cards != HAND_EVAL_BOARD_CARDS) {
+        for (int i = 0; i < num_hands; i++) scores[i] = hand_board_score(board, hole_cards[i]);
+        return;
+    }
+
+    // never run a kernel the cpu cannot execute, fall back to the best one it can.
+    // the vector kernels probe the perfect hash directly, so they also need the mapped tables
+    if (kernel > best_kernel) kernel = best_kernel;
+    if (!noflush_table) kernel = HAND_EVAL_KERNEL_SCALAR;
+
+#ifdef HAND_EVAL_X86
+    // whatever is left over after the widest kernel drops down to the next narrower one
+    if (kernel >= HAND_EVAL_KERNEL_AVX2) {
+        done += batch_avx2(board, hole_cards + done, num_hands - done, scores + done);
+    }
+    if (kernel >= HAND_EVAL_KERNEL_SSE4) {
+        done += batch_sse4(board, hole_cards + done, num_hands - done, scores + done);
+    }
+#endif
+
+    batch_scalar(board, hole_cards, done, num_hands, scores);
+}
+
+void hand_eval_batch_kernel(hand_eval_kernel_t kernel, const card_t board[HAND_EVAL_BOARD_CARDS],
+                            const card_t hole_cards[][2], int num_hands, int scores[]) {
+    // the board sums come from card_keys and the scores from the flush and key tables
+    hand_eval_init();
+
+    // only the sums matter here, skip scoring the board on its own after every card
+    hand_board_t board_state;
+    hand_board_reset(&board_state);
+    for (int i = 0; i < HAND_EVAL_BOARD_CARDS; i++) board_add_card(&board_state, board[i]);
+
+    hand_eval_batch_board(kernel, &board_state, hole_cards, num_hands, scores);
+}
+
+void hand_eval_batch(const card_t board[HAND_EVAL_BOARD_CARDS], const card_t hole_cards[][2],
+                     int num_hands, int scores[]) {
+    hand_eval_batch_kernel(hand_eval_best_kernel(), board, hole_cards, num_hands, scores);
+}
+
+// ---------------------------- Incremental board ---------------------------- //
+
+void hand_board_reset(hand_board_t *board) {
+    memset(board, 0, sizeof(hand_board_t));
+}
+
+void hand_board_add(hand_board_t *board, card_t card) {
+    board_add_card(board, card);
+    board->best_score = hand_eval_card_set(board->cards);
+}
+
+int hand_board_score(const hand_board_t *board, const card_t hole[2]) {
+    if (board->num_cards == HAND_EVAL_BOARD_CARDS) return score_with_board(board, hole);
+    return hand_eval_card_set(board->cards | card_set_of(hole[0]) | card_set_of(hole[1]));
+}
@@ -42,13 +42,15 @@ void log_info(const char *fmt_str, ...)
         va_list va;
         va_start(va, fmt_str);
 
+        // one line at a time, when the threads of a process log at once
+        flockfile(log_file);
         fprintf(log_file, "[INFO] ");
         vfprintf(log_file, fmt_str, va);
         fprintf(log_file, "\n");
+        fflush(log_file);
+        funlockfile(log_file);
 
         va_end(va);
-
-        fflush(log_file);
     }
 }
 
@@ -60,13 +62,14 @@ void log_debug(const char *fmt_str, ...)
         va_list va;
         va_start(va, fmt_str);
 
+        flockfile(log_file);
         fprintf(log_file, "[DEBUG] ");
         vfprintf(log_file, fmt_str, va);
         fprintf(log_file, "\n");
+        fflush(log_file);
+        funlockfile(log_file);
 
         va_end(va);
-
-        fflush(log_file);
     }
 }
 
@@ -77,13 +80,14 @@ void log_err(const char *fmt_str, ...)
         va_list va;
         va_start(va, fmt_str);
 
+        flockfile(log_file);
         fprintf(log_file, "[ERROR] ");
         vfprintf(log_file, fmt_str, va);
         fprintf(log_file, "\n");
+        fflush(log_file);
+        funlockfile(log_file);
 
         va_end(va);
-
-        fflush(log_file);
     }
 }
 
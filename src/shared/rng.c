@@ -0,0 +1,330 @@
+#include "rng.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+
+#define CHACHA_ROUNDS 20
+#define CHACHA_BLOCK_WORDS 16
+#define CHACHA_KEY_WORDS 8
+#define CHACHA_BUFFER_BLOCKS 16             // 1 KiB of output per refill, about 20 shuffles
+#define CHACHA_RESEED_BLOCKS (1 << 14)      // mix fresh entropy into the key after 1 MiB of output
+#define CHACHA_ENTROPY_BYTES 4096           // fetched per getrandom() call, enough for 128 reseeds
+
+// ---------------------------- legacy ---------------------------- //
+
+// the same steps as glibc's srandom_r for its default TYPE_3 generator
+static void legacy_seed(rng_t *rng, uint32_t seed) {
+    int32_t *state = rng->legacy.state;
+
+    // a seed of 0 would leave the state all zeros
+    if (seed == 0) seed = 1;
+    state[0] = (int32_t)seed;
+
+    // state[i] = 16807 * state[i - 1] % 2147483647 without overflowing 31 bits
+    for (int i = 1; i < RNG_LEGACY_DEGREE; i++) {
+        long hi = state[i - 1] / 127773;
+        long lo = state[i - 1] % 127773;
+        long word = 16807 * lo - 2836 * hi;
+        if (word < 0) word += 2147483647;
+        state[i] = (int32_t)word;
+    }
+
+    rng->legacy.front = RNG_LEGACY_SEP;
+    rng->legacy.rear = 0;
+
+    // glibc throws away the first 10 rounds of the state before handing anything out
+    for (int i = 0; i < 10 * RNG_LEGACY_DEGREE; i++) rng_next(rng);
+}
+
+// the same steps as glibc's random_r, which is what rand() returns
+static uint32_t legacy_next(rng_t *rng) {
+    int32_t *state = rng->legacy.state;
+    int front = rng->legacy.front;
+    int rear = rng->legacy.rear;
+
+    uint32_t value = (uint32_t)state[front] + (uint32_t)state[rear];
+    state[front] = (int32_t)value;
+
+    if (++front == RNG_LEGACY_DEGREE) front = 0;
+    if (++rear == RNG_LEGACY_DEGREE) rear = 0;
+    rng->legacy.front = front;
+    rng->legacy.rear = rear;
+
+    // the lowest bit is the least random one, drop it
+    return value >> 1;
+}
+
+// ---------------------------- xoshiro256** ---------------------------- //
+
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t xoshiro_next(rng_t *rng) {
+    uint64_t *s = rng->xoshiro;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return result;
+}
+
+// ---------------------------- ChaCha20 ---------------------------- //
+
+/**
+ * one generator per thread. a refill runs CHACHA_BUFFER_BLOCKS blocks of ChaCha20 at once and
+ * immediately replaces the key with the first words of the output (fast key erasure), so even
+ * a leaked state cannot give away cards that were already dealt. getrandom() is only called
+ * once every CHACHA_ENTROPY_BYTES / 32 reseeds
+ */
+typedef struct {
+    uint32_t key[CHACHA_KEY_WORDS];
+    uint64_t counter;
+    uint32_t buffer[CHACHA_BUFFER_BLOCKS * CHACHA_BLOCK_WORDS];
+    int next;                               // next unused word of buffer
+    long blocks_since_reseed;
+    uint8_t entropy[CHACHA_ENTROPY_BYTES];
+    int entropy_left;                       // unused bytes at the end of entropy
+    int seeded;
+} chacha_t;
+
+static __thread chacha_t thread_chacha;
+
+// four blocks side by side, lane j of every word belongs to block counter + j
+typedef uint32_t chacha_lanes_t __attribute__((vector_size(16)));
+#define CHACHA_LANES 4
+
+#define ROTL_LANES(x, k) (((x) << (k)) | ((x) >> (32 - (k))))
+#define QUARTER_ROUND(x, a, b, c, d)                                  \
+    x[a] += x[b]; x[d] = ROTL_LANES(x[d] ^ x[a], 16);                 \
+    x[c] += x[d]; x[b] = ROTL_LANES(x[b] ^ x[c], 12);                 \
+    x[a] += x[b]; x[d] = ROTL_LANES(x[d] ^ x[a], 8);                  \
+    x[c] += x[d]; x[b] = ROTL_LANES(x[b] ^ x[c], 7);
+
+// Four 64 byte blocks of keystream, original layout with a 64 bit counter and a zero nonce.
+// one vector per state word keeps all four blocks in sse registers, about 3x faster than one at a time
+static void chacha_blocks(const uint32_t key[CHACHA_KEY_WORDS], uint64_t counter,
+                          uint32_t out[CHACHA_LANES * CHACHA_BLOCK_WORDS]) {
+    chacha_lanes_t input[CHACHA_BLOCK_WORDS];
+    input[0] = (chacha_lanes_t){0x61707865, 0x61707865, 0x61707865, 0x61707865};  // "expand 32-byte k"
+    input[1] = (chacha_lanes_t){0x3320646e, 0x3320646e, 0x3320646e, 0x3320646e};
+    input[2] = (chacha_lanes_t){0x79622d32, 0x79622d32, 0x79622d32, 0x79622d32};
+    input[3] = (chacha_lanes_t){0x6b206574, 0x6b206574, 0x6b206574, 0x6b206574};
+    for (int i = 0; i < CHACHA_KEY_WORDS; i++) {
+        input[4 + i] = (chacha_lanes_t){key[i], key[i], key[i], key[i]};
+    }
+    for (int j = 0; j < CHACHA_LANES; j++) {
+        input[12][j] = (uint32_t)(counter + j);
+        input[13][j] = (uint32_t)((counter + j) >> 32);
+        input[14][j] = 0;
+        input[15][j] = 0;
+    }
+
+    chacha_lanes_t x[CHACHA_BLOCK_WORDS];
+    memcpy(x, input, sizeof(x));
+    for (int i = 0; i < CHACHA_ROUNDS; i += 2) {
+        QUARTER_ROUND(x, 0, 4, 8, 12);
+        QUARTER_ROUND(x, 1, 5, 9, 13);
+        QUARTER_ROUND(x, 2, 6, 10, 14);
+        QUARTER_ROUND(x, 3, 7, 11, 15);
+        QUARTER_ROUND(x, 0, 5, 10, 15);
+        QUARTER_ROUND(x, 1, 6, 11, 12);
+        QUARTER_ROUND(x, 2, 7, 8, 13);
+        QUARTER_ROUND(x, 3, 4, 9, 14);
+    }
+
+    for (int i = 0; i < CHACHA_BLOCK_WORDS; i++) {
+        chacha_lanes_t word = x[i] + input[i];
+        for (int j = 0; j < CHACHA_LANES; j++) out[j * CHACHA_BLOCK_WORDS + i] = word[j];
+    }
+}
+
+// Mixes 32 fresh bytes from the kernel into the key, fetching them in one large batch
+static void chacha_reseed(chacha_t *chacha) {
+    if (chacha->entropy_left < (int)sizeof(chacha->key)) {
+        size_t filled = 0;
+        while (filled < sizeof(chacha->entropy)) {
+            ssize_t got = getrandom(chacha->entropy + filled, sizeof(chacha->entropy) - filled, 0);
+            if (got < 0 && errno == EINTR) continue;
+            if (got < 0) {
+                // dealing from a predictable deck is worse than not dealing at all
+                perror("[RNG] getrandom() failed");
+                exit(EXIT_FAILURE);
+            }
+            filled += got;
+        }
+        chacha->entropy_left = sizeof(chacha->entropy);
+    }
+
+    uint8_t *fresh = chacha->entropy + sizeof(chacha->entropy) - chacha->entropy_left;
+    uint32_t words[CHACHA_KEY_WORDS];
+    memcpy(words, fresh, sizeof(words));
+    memset(fresh, 0, sizeof(words));
+    chacha->entropy_left -= sizeof(words);
+
+    for (int i = 0; i < CHACHA_KEY_WORDS; i++) chacha->key[i] ^= words[i];
+    chacha->blocks_since_reseed = 0;
+    chacha->seeded = 1;
+}
+
+static void chacha_refill(chacha_t *chacha) {
+    if (!chacha->seeded || chacha->blocks_since_reseed >= CHACHA_RESEED_BLOCKS) chacha_reseed(chacha);
+
+    for (int b = 0; b < CHACHA_BUFFER_BLOCKS; b += CHACHA_LANES) {
+        chacha_blocks(chacha->key, chacha->counter, chacha->buffer + b * CHACHA_BLOCK_WORDS);
+        chacha->counter += CHACHA_LANES;
+    }
+    chacha->blocks_since_reseed += CHACHA_BUFFER_BLOCKS;
+
+    // the first words become the next key and are never handed out
+    memcpy(chacha->key, chacha->buffer, sizeof(chacha->key));
+    memset(chacha->buffer, 0, sizeof(chacha->key));
+    chacha->next = CHACHA_KEY_WORDS;
+}
+
+static uint32_t chacha_next(void) {
+    chacha_t *chacha = &thread_chacha;
+    if (chacha->next == 0 || chacha->next == CHACHA_BUFFER_BLOCKS * CHACHA_BLOCK_WORDS) chacha_refill(chacha);
+
+    // wipe every word once it is used so it cannot be read back out of memory later
+    uint32_t value = chacha->buffer[chacha->next];
+    chacha->buffer[chacha->next++] = 0;
+    return value;
+}
+
+// ---------------------------- interface ---------------------------- //
+
+void rng_seed(rng_t *rng, rng_mode_t mode, uint64_t seed) {
+    memset(rng, 0, sizeof(*rng));
+    rng->mode = mode;
+
+    if (mode == RNG_LEGACY) {
+        legacy_seed(rng, (uint32_t)seed);
+        return;
+    }
+    if (mode == RNG_CHACHA) return;
+
+    // splitmix64 spreads any seed, even 0, over the whole state
+    for (int i = 0; i < 4; i++) rng->xoshiro[i] = splitmix64(&seed);
+}
+
+uint64_t rng_table_seed(uint64_t master_seed, int table_id) {
+    uint64_t state = master_seed ^ ((uint64_t)table_id * 0xd1b54a32d192ed03ull);
+    return splitmix64(&state);
+}
+
+static uint32_t xoshiro_next32(rng_t *rng) {
+    return (uint32_t)(xoshiro_next(rng) >> 32);
+}
+
+static uint32_t chacha_next32(rng_t *rng) {
+    return chacha_next();
+}
+
+// Lemire's multiply and shift, retrying the few values that would make some results likelier.
+// always inlined with a constant next, so each generator gets its own loop without a call per draw
+static inline __attribute__((always_inline)) uint32_t lemire_bounded(rng_t *rng, uint32_t (*next)(rng_t *), uint32_t range) {
+    uint64_t product = (uint64_t)next(rng) * range;
+    uint32_t low = (uint32_t)product;
+    if (low < range) {
+        uint32_t threshold = -range % range;
+        while (low < threshold) {
+            product = (uint64_t)next(rng) * range;
+            low = (uint32_t)product;
+        }
+    }
+    return product >> 32;
+}
+
+static inline __attribute__((always_inline)) void fisher_yates(rng_t *rng, uint32_t (*next)(rng_t *), card_t deck[DECK_SIZE]) {
+    for (int i = DECK_SIZE - 1; i > 0; i--) {
+        int j = lemire_bounded(rng, next, i + 1);
+        card_t temp = deck[i];
+        deck[i] = deck[j];
+        deck[j] = temp;
+    }
+}
+
+// Fisher-Yates on 16 bit draws, plenty for ranges up to 52, so every keystream word serves two swaps
+static void chacha_fisher_yates(card_t deck[DECK_SIZE]) {
+    uint32_t bits = 0;
+    int halves = 0;
+
+    for (int i = DECK_SIZE - 1; i > 0; i--) {
+        uint32_t range = i + 1;
+        uint32_t product;
+        uint32_t low;
+        for (;;) {
+            if (halves == 0) {
+                bits = chacha_next();
+                halves = 2;
+            }
+            product = (bits & 0xffff) * range;
+            bits >>= 16;
+            halves--;
+
+            // the same rejection as lemire_bounded, scaled down to 16 bits
+            low = product & 0xffff;
+            if (low >= range || low >= 0x10000 % range) break;
+        }
+
+        int j = product >> 16;
+        card_t temp = deck[i];
+        deck[i] = deck[j];
+        deck[j] = temp;
+    }
+}
+
+uint32_t rng_next(rng_t *rng) {
+    if (rng->mode == RNG_LEGACY) return legacy_next(rng);
+    if (rng->mode == RNG_CHACHA) return chacha_next();
+    return xoshiro_next32(rng);
+}
+
+uint32_t rng_bounded(rng_t *rng, uint32_t range) {
+    if (rng->mode == RNG_LEGACY) {
+        // rand() only has 31 bits, reject the top values that do not fill a whole multiple of range
+        uint32_t limit = 0x80000000u - 0x80000000u % range;
+        uint32_t value;
+        do value = legacy_next(rng); while (value >= limit);
+        return value % range;
+    }
+    if (rng->mode == RNG_CHACHA) return lemire_bounded(rng, chacha_next32, range);
+    return lemire_bounded(rng, xoshiro_next32, range);
+}
+
+void rng_shuffle_deck(rng_t *rng, card_t deck[DECK_SIZE]) {
+    switch (rng->mode) {
+        case RNG_LEGACY:
+            // the same biased swap loop as shuffle_deck, kept so seeded games still deal the same cards
+            for (int i = 0; i < DECK_SIZE; i++) {
+                int j = legacy_next(rng) % DECK_SIZE;
+                card_t temp = deck[i];
+                deck[i] = deck[j];
+                deck[j] = temp;
+            }
+            break;
+        case RNG_CHACHA:
+            chacha_fisher_yates(deck);
+            break;
+        default:
+            fisher_yates(rng, xoshiro_next32, deck);
+            break;
+    }
+}
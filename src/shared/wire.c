@@ -0,0 +1,298 @@
+#include <string.h>
+
+#include "wire.h"
+
+// the longest varint an int takes
+#define MAX_VARINT 5
+
+// the type byte of an INFO sent as a delta, from version 2 on
+#define INFO_DELTA (0x80 | INFO)
+
+// the fields of an INFO a delta can list, see info_fields
+#define INFO_FIELDS 29
+
+// Points fields at the fields of an INFO in the order a delta lists them
+static void info_fields(info_packet_t *info, int *fields[INFO_FIELDS]) {
+    int n = 0;
+    for (int i = 0; i < 2; i++) fields[n++] = &info->player_cards[i];
+    for (int i = 0; i < 5; i++) fields[n++] = &info->community_cards[i];
+    fields[n++] = &info->pot_size;
+    fields[n++] = &info->dealer;
+    fields[n++] = &info->player_turn;
+    fields[n++] = &info->bet_size;
+    for (int i = 0; i < MAX_PLAYERS; i++) fields[n++] = &info->player_stacks[i];
+    for (int i = 0; i < MAX_PLAYERS; i++) fields[n++] = &info->player_bets[i];
+    for (int i = 0; i < MAX_PLAYERS; i++) fields[n++] = &info->player_status[i];
+}
+
+// Whether a field of info_fields is a card, a seat or a status, which take a byte, or chips
+static int small_field(int field) {
+    return field < 7 || field == 8 || field == 9 || field >= 23;
+}
+
+// ---------------------------- Encoding ---------------------------- //
+
+static uint8_t *put_varint(uint8_t *pos, uint32_t value) {
+    while (value >= 0x80) {
+        *pos++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *pos++ = (uint8_t)value;
+    return pos;
+}
+
+// Chips as a zigzag varint, so a small negative number stays short too
+static uint8_t *put_int(uint8_t *pos, int value) {
+    return put_varint(pos, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+// A card or a seat in a byte, NOCARD and -1 as 0
+static uint8_t *put_small(uint8_t *pos, int value) {
+    *pos++ = (uint8_t)(value + 1);
+    return pos;
+}
+
+// The six seats' statuses at two bits each
+static uint8_t *put_statuses(uint8_t *pos, const int status[MAX_PLAYERS]) {
+    unsigned bits = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++) bits |= (unsigned)(status[i] & 3) << (2 * i);
+    *pos++ = (uint8_t)bits;
+    *pos++ = (uint8_t)(bits >> 8);
+    return pos;
+}
+
+// Puts the length in front of a body that was written one byte into buf, every body of version 1 is shorter than 128
+static size_t finish_frame(uint8_t *buf, const uint8_t *end) {
+    size_t body = end - (buf + 1);
+    buf[0] = (uint8_t)body;
+    return body + 1;
+}
+
+// The fields of an INFO that differ from the base, with a bit for each in the mask
+static uint8_t *put_delta(uint8_t *pos, const info_packet_t *info, info_packet_t *base) {
+    int *now[INFO_FIELDS], *then[INFO_FIELDS];
+    info_fields((info_packet_t *)info, now);
+    info_fields(base, then);
+
+    uint32_t mask = 0;
+    for (int i = 0; i < INFO_FIELDS; i++) {
+        if (*now[i] != *then[i]) mask |= 1u << i;
+    }
+    pos = put_varint(pos, mask);
+    for (int i = 0; i < INFO_FIELDS; i++) {
+        if (mask & (1u << i)) pos = small_field(i) ? put_small(pos, *now[i]) : put_int(pos, *now[i]);
+    }
+    return pos;
+}
+
+size_t wire_encode_server(int version, const server_packet_t *pkt, wire_base_t *base, uint8_t *buf) {
+    if (version == WIRE_RAW) {
+        memcpy(buf, pkt, sizeof(server_packet_t));
+        return sizeof(server_packet_t);
+    }
+
+    int delta = version >= WIRE_DELTA && base;
+    uint8_t *pos = buf + 1;
+    *pos++ = (uint8_t)pkt->packet_type;
+    if (pkt->packet_type == INFO && delta && base->valid) {
+        buf[1] = INFO_DELTA;
+        pos = put_delta(pos, &pkt->info, &base->info);
+    } else if (pkt->packet_type == INFO) {
+        const info_packet_t *info = &pkt->info;
+        for (int i = 0; i < 2; i++) pos = put_small(pos, info->player_cards[i]);
+        for (int i = 0; i < 5; i++) pos = put_small(pos, info->community_cards[i]);
+        pos = put_int(pos, info->pot_size);
+        pos = put_small(pos, info->dealer);
+        pos = put_small(pos, info->player_turn);
+        pos = put_int(pos, info->bet_size);
+        for (int i = 0; i < MAX_PLAYERS; i++) pos = put_int(pos, info->player_stacks[i]);
+        for (int i = 0; i < MAX_PLAYERS; i++) pos = put_int(pos, info->player_bets[i]);
+        pos = put_statuses(pos, info->player_status);
+    } else if (pkt->packet_type == END) {
+        const end_packet_t *end = &pkt->end;
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            pos = put_small(pos, end->player_cards[i][0]);
+            pos = put_small(pos, end->player_cards[i][1]);
+        }
+        for (int i = 0; i < 5; i++) pos = put_small(pos, end->community_cards[i]);
+        for (int i = 0; i < MAX_PLAYERS; i++) pos = put_int(pos, end->player_stacks[i]);
+        pos = put_int(pos, end->pot_size);
+        pos = put_small(pos, end->dealer);
+        pos = put_small(pos, end->winner);
+        pos = put_statuses(pos, end->player_status);
+    } else if ((pkt->packet_type == ACK || pkt->packet_type == NACK) && version >= WIRE_SEQ) {
+        pos = put_varint(pos, pkt->reply.seq);
+    }
+
+    if (delta && pkt->packet_type == INFO) {
+        base->info = pkt->info;
+        base->valid = 1;
+    } else if (delta && pkt->packet_type == END) {
+        base->valid = 0;
+    }
+    return finish_frame(buf, pos);
+}
+
+size_t wire_encode_client(int version, const client_packet_t *pkt, uint8_t *buf) {
+    if (version == WIRE_RAW) {
+        memcpy(buf, pkt, WIRE_RAW_CLIENT);
+        return WIRE_RAW_CLIENT;
+    }
+
+    uint8_t *pos = buf + 1;
+    *pos++ = (uint8_t)pkt->packet_type;
+    if (version >= WIRE_SEQ) pos = put_varint(pos, pkt->seq);
+    if (pkt->packet_type == RAISE || pkt->packet_type == JOIN) pos = put_int(pos, pkt->params[0]);
+    return finish_frame(buf, pos);
+}
+
+// ---------------------------- Decoding ---------------------------- //
+
+// The body of a frame being read, bad once a read ran past its end
+typedef struct {
+    const uint8_t *pos;
+    const uint8_t *end;
+    int bad;
+} reader_t;
+
+static uint32_t get_varint(reader_t *reader) {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 7 * MAX_VARINT; shift += 7) {
+        if (reader->pos == reader->end) break;
+        uint8_t byte = *reader->pos++;
+        value |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    reader->bad = 1;
+    return 0;
+}
+
+static int get_int(reader_t *reader) {
+    uint32_t value = get_varint(reader);
+    return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+static int get_small(reader_t *reader) {
+    if (reader->pos == reader->end) {
+        reader->bad = 1;
+        return -1;
+    }
+    return *reader->pos++ - 1;
+}
+
+static void get_statuses(reader_t *reader, int status[MAX_PLAYERS]) {
+    unsigned bits = 0;
+    if (reader->end - reader->pos < 2) reader->bad = 1;
+    else bits = reader->pos[0] | reader->pos[1] << 8;
+    reader->pos += reader->bad ? 0 : 2;
+    for (int i = 0; i < MAX_PLAYERS; i++) status[i] = (bits >> (2 * i)) & 3;
+}
+
+// Finds the body of the first frame, 1 once it is all there, 0 if more bytes are needed, -1 if it is longer than max_body
+static int open_frame(const uint8_t *buf, size_t len, size_t max_body, reader_t *reader, size_t *used) {
+    reader_t prefix = { .pos = buf, .end = buf + (len < MAX_VARINT ? len : MAX_VARINT) };
+    uint32_t body = get_varint(&prefix);
+    if (prefix.bad) return len < MAX_VARINT ? 0 : -1;
+    if (body == 0 || body > max_body) return -1;
+
+    size_t header = prefix.pos - buf;
+    if (len < header + body) return 0;
+    reader->pos = prefix.pos;
+    reader->end = prefix.pos + body;
+    reader->bad = 0;
+    *used = header + body;
+    return 1;
+}
+
+// Applies the fields a delta lists to the base
+static void get_delta(reader_t *reader, info_packet_t *base) {
+    int *fields[INFO_FIELDS];
+    info_fields(base, fields);
+
+    uint32_t mask = get_varint(reader);
+    if (mask >> INFO_FIELDS) reader->bad = 1;
+    for (int i = 0; i < INFO_FIELDS && !reader->bad; i++) {
+        if (mask & (1u << i)) *fields[i] = small_field(i) ? get_small(reader) : get_int(reader);
+    }
+}
+
+int wire_decode_server(int version, const uint8_t *buf, size_t len, wire_base_t *base, server_packet_t *pkt, size_t *used) {
+    if (version == WIRE_RAW) {
+        if (len < sizeof(server_packet_t)) return 0;
+        memcpy(pkt, buf, sizeof(server_packet_t));
+        *used = sizeof(server_packet_t);
+        return 1;
+    }
+
+    reader_t reader;
+    int opened = open_frame(buf, len, WIRE_MAX_FRAME, &reader, used);
+    if (opened <= 0) return opened;
+
+    int delta = version >= WIRE_DELTA && base;
+    memset(pkt, 0, sizeof(server_packet_t));
+    pkt->packet_type = *reader.pos++;
+    if (pkt->packet_type == INFO_DELTA) {
+        // a delta of nothing, or one the connection should not have been sent
+        if (!delta || !base->valid) return -1;
+        get_delta(&reader, &base->info);
+        pkt->packet_type = INFO;
+        pkt->info = base->info;
+    } else if (pkt->packet_type == INFO) {
+        info_packet_t *info = &pkt->info;
+        for (int i = 0; i < 2; i++) info->player_cards[i] = get_small(&reader);
+        for (int i = 0; i < 5; i++) info->community_cards[i] = get_small(&reader);
+        info->pot_size = get_int(&reader);
+        info->dealer = get_small(&reader);
+        info->player_turn = get_small(&reader);
+        info->bet_size = get_int(&reader);
+        for (int i = 0; i < MAX_PLAYERS; i++) info->player_stacks[i] = get_int(&reader);
+        for (int i = 0; i < MAX_PLAYERS; i++) info->player_bets[i] = get_int(&reader);
+        get_statuses(&reader, info->player_status);
+    } else if (pkt->packet_type == END) {
+        end_packet_t *end = &pkt->end;
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            end->player_cards[i][0] = get_small(&reader);
+            end->player_cards[i][1] = get_small(&reader);
+        }
+        for (int i = 0; i < 5; i++) end->community_cards[i] = get_small(&reader);
+        for (int i = 0; i < MAX_PLAYERS; i++) end->player_stacks[i] = get_int(&reader);
+        end->pot_size = get_int(&reader);
+        end->dealer = get_small(&reader);
+        end->winner = get_small(&reader);
+        get_statuses(&reader, end->player_status);
+    } else if ((pkt->packet_type == ACK || pkt->packet_type == NACK) && version >= WIRE_SEQ) {
+        pkt->reply.seq = get_varint(&reader);
+    } else if (pkt->packet_type > HALT) {
+        return -1;
+    }
+    if (reader.bad) return -1;
+
+    if (delta && pkt->packet_type == INFO) {
+        base->info = pkt->info;
+        base->valid = 1;
+    } else if (delta && pkt->packet_type == END) {
+        base->valid = 0;
+    }
+    return 1;
+}
+
+int wire_decode_client(int version, const uint8_t *buf, size_t len, client_packet_t *pkt, size_t *used) {
+    if (version == WIRE_RAW) {
+        if (len < WIRE_RAW_CLIENT) return 0;
+        memset(pkt, 0, sizeof(client_packet_t));
+        memcpy(pkt, buf, WIRE_RAW_CLIENT);
+        *used = WIRE_RAW_CLIENT;
+        return 1;
+    }
+
+    reader_t reader;
+    int opened = open_frame(buf, len, sizeof(client_packet_t) - 1, &reader, used);
+    if (opened <= 0) return opened;
+
+    memset(pkt, 0, sizeof(client_packet_t));
+    pkt->packet_type = *reader.pos++;
+    if (pkt->packet_type > SNAPSHOT) return -1;
+    if (version >= WIRE_SEQ) pkt->seq = get_varint(&reader);
+    if (pkt->packet_type == RAISE || pkt->packet_type == JOIN) pkt->params[0] = get_int(&reader);
+    return reader.bad ? -1 : 1;
+}
@@ -0,0 +1,23 @@
+/**
+ * Writes the precomputed hand evaluator tables that hand_eval_init maps at startup.
+ *
+ * usage: ./build/tool.hand_eval_tables [path]
+ *
+ * path defaults to HAND_EVAL_TABLES_PATH, normally this is run through `make tables`
+ */
+
+#include <stdio.h>
+
+#include "hand_eval.h"
+
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : HAND_EVAL_TABLES_PATH;
+
+    if (hand_eval_write_tables(path) < 0) {
+        perror(path);
+        return 1;
+    }
+
+    printf("wrote hand evaluator tables v%d to %s\n", HAND_EVAL_TABLES_VERSION, path);
+    return 0;
+}